@@ -1,3 +1,6 @@
+#pragma once
+
+#include <algorithm>
 #include <range/v3/range/conversion.hpp>
 #include <range/v3/view/filter.hpp>
 #include <range/v3/view/iota.hpp>
@@ -5,15 +8,14 @@
 #include "common/bits.h"
 #include "arm7/arm7.h"
 
+template <bool accumulate, bool set_condition_codes>
 void ARM7::ARM_Multiply(const u32 opcode) {
-    const bool accumulate = Common::IsBitSet<21>(opcode);
-    const bool set_condition_codes = Common::IsBitSet<20>(opcode);
     const std::unsigned_integral auto rd = Common::GetBitRange<19, 16>(opcode);
     const std::unsigned_integral auto rn = Common::GetBitRange<15, 12>(opcode);
     const std::unsigned_integral auto rs = Common::GetBitRange<11, 8>(opcode);
     const std::unsigned_integral auto rm = Common::GetBitRange<3, 0>(opcode);
 
-    timers.AdvanceCycles(1, Timers::CycleType::Sequential);
+    AddCycles(1, CycleType::Sequential);
 
     const auto m = [&]() -> u16 {
         const u32 multiplier = GetRegister(rs);
@@ -30,35 +32,32 @@ void ARM7::ARM_Multiply(const u32 opcode) {
     }();
 
     u32 result = GetRegister(rm) * GetRegister(rs);
-    timers.AdvanceCycles(m, Timers::CycleType::Internal);
+    AddCycles(m, CycleType::Internal);
 
-    if (accumulate) {
+    if constexpr (accumulate) {
         result += GetRegister(rn);
-        timers.AdvanceCycles(1, Timers::CycleType::Internal);
+        AddCycles(1, CycleType::Internal);
     }
 
     SetRegister(rd, result);
 
-    if (set_condition_codes) {
-        cpsr.flags.negative = Common::IsBitSet<31>(result);
-        cpsr.flags.zero = (result == 0);
+    if constexpr (set_condition_codes) {
+        SetNZ(Common::IsBitSet<31>(result), result == 0);
     }
 }
 
+template <bool sign, bool accumulate, bool set_condition_codes>
 void ARM7::ARM_MultiplyLong(const u32 opcode) {
-    const bool sign = Common::IsBitSet<22>(opcode);
-    const bool accumulate = Common::IsBitSet<21>(opcode);
-    const bool set_condition_codes = Common::IsBitSet<20>(opcode);
     const std::unsigned_integral auto rdhi = Common::GetBitRange<19, 16>(opcode);
     const std::unsigned_integral auto rdlo = Common::GetBitRange<15, 12>(opcode);
     const std::unsigned_integral auto rs = Common::GetBitRange<11, 8>(opcode);
     const std::unsigned_integral auto rm = Common::GetBitRange<3, 0>(opcode);
 
-    timers.AdvanceCycles(1, Timers::CycleType::Sequential);
+    AddCycles(1, CycleType::Sequential);
     const auto m = [&]() -> u16 {
         const u32 multiplier = GetRegister(rs);
 
-        if (sign) {
+        if constexpr (sign) {
             if (Common::GetBitRange<31, 8>(multiplier) == 0 || Common::GetBitRange<31, 8>(multiplier) == 0xFFFFFF) {
                 return 1;
             } else if (Common::GetBitRange<31, 16>(multiplier) == 0 || Common::GetBitRange<31, 16>(multiplier) == 0xFFFF) {
@@ -80,47 +79,45 @@ void ARM7::ARM_MultiplyLong(const u32 opcode) {
             }
         }
     }();
-    timers.AdvanceCycles(accumulate ? (m + 2) : (m + 1), Timers::CycleType::Internal);
+    AddCycles(accumulate ? (m + 2) : (m + 1), CycleType::Internal);
 
-    if (sign) {
+    if constexpr (sign) {
         const s64 rm_se = (static_cast<s64>(GetRegister(rm)) << 32) >> 32;
         const s64 rs_se = (static_cast<s64>(GetRegister(rs)) << 32) >> 32;
 
         s64 result = rm_se * rs_se;
-        if (accumulate) {
+        if constexpr (accumulate) {
             result += ((static_cast<s64>(GetRegister(rdhi)) << 32) | GetRegister(rdlo));
         }
         SetRegister(rdlo, Common::GetBitRange<31, 0>(result));
         SetRegister(rdhi, Common::GetBitRange<63, 32>(result));
 
-        if (set_condition_codes) {
-            cpsr.flags.negative = Common::IsBitSet<63>(result);
-            cpsr.flags.zero = (result == 0);
+        if constexpr (set_condition_codes) {
+            SetNZ(Common::IsBitSet<63>(result), result == 0);
         }
     } else {
         u64 result = static_cast<u64>(GetRegister(rm)) * static_cast<u64>(GetRegister(rs));
-        if (accumulate) {
+        if constexpr (accumulate) {
             result += ((static_cast<u64>(GetRegister(rdhi)) << 32) | GetRegister(rdlo));
         }
         SetRegister(rdlo, Common::GetBitRange<31, 0>(result));
         SetRegister(rdhi, Common::GetBitRange<63, 32>(result));
 
-        if (set_condition_codes) {
-            cpsr.flags.negative = Common::IsBitSet<63>(result);
-            cpsr.flags.zero = (result == 0);
+        if constexpr (set_condition_codes) {
+            SetNZ(Common::IsBitSet<63>(result), result == 0);
         }
     }
 }
 
+template <bool swap_byte>
 void ARM7::ARM_SingleDataSwap(const u32 opcode) {
-    const bool swap_byte = Common::IsBitSet<22>(opcode);
     const std::unsigned_integral auto rn = Common::GetBitRange<19, 16>(opcode);
     const std::unsigned_integral auto rd = Common::GetBitRange<15, 12>(opcode);
     const std::unsigned_integral auto rm = Common::GetBitRange<3, 0>(opcode);
 
     const u32 address = GetRegister(rn);
 
-    if (swap_byte) {
+    if constexpr (swap_byte) {
         const u8 swap_value = bus.Read8(address);
         bus.Write8(address, GetRegister(rm));
         SetRegister(rd, swap_value);
@@ -131,50 +128,31 @@ void ARM7::ARM_SingleDataSwap(const u32 opcode) {
     }
 }
 
+template <bool pre_indexing, bool add_offset_to_base, bool write_back, bool load_from_memory, bool sign, bool halfword>
 void ARM7::ARM_HalfwordDataTransferRegister(const u32 opcode) {
-    const bool load_from_memory = Common::IsBitSet<20>(opcode);
-    const bool sign = Common::IsBitSet<6>(opcode);
-    const bool halfword = Common::IsBitSet<5>(opcode);
-
-    const u8 conditions = (load_from_memory << 1) | halfword;
-    switch (conditions) {
-        case 0b00:
-            ARM_SingleDataSwap(opcode);
-            break;
-        case 0b01:
-            ARM_HalfwordDataTransferRegister_Impl<false, true>(opcode, sign);
-            // TODO: STRSH?
-            timers.AdvanceCycles(2, Timers::CycleType::Nonsequential);
-            break;
-        case 0b10:
-            ARM_HalfwordDataTransferRegister_Impl<true, false>(opcode, sign);
-            timers.AdvanceCycles(1, Timers::CycleType::Sequential);
-            timers.AdvanceCycles(1, Timers::CycleType::Nonsequential);
-            timers.AdvanceCycles(1, Timers::CycleType::Internal);
-            break;
-        case 0b11:
-            ARM_HalfwordDataTransferRegister_Impl<true, true>(opcode, sign);
-            timers.AdvanceCycles(1, Timers::CycleType::Sequential);
-            timers.AdvanceCycles(1, Timers::CycleType::Nonsequential);
-            timers.AdvanceCycles(1, Timers::CycleType::Internal);
-            break;
-        default:
-            UNREACHABLE();
+    if constexpr (!load_from_memory && !halfword) {
+        ARM_SingleDataSwap<false>(opcode);
+    } else if constexpr (!load_from_memory) {
+        ARM_HalfwordDataTransferRegister_Impl<pre_indexing, add_offset_to_base, write_back, false, true, sign>(opcode);
+        // TODO: STRSH?
+        AddCycles(2, CycleType::Nonsequential);
+    } else {
+        ARM_HalfwordDataTransferRegister_Impl<pre_indexing, add_offset_to_base, write_back, true, halfword, sign>(opcode);
+        AddCycles(1, CycleType::Sequential);
+        AddCycles(1, CycleType::Nonsequential);
+        AddCycles(1, CycleType::Internal);
     }
 }
 
-template <bool load_from_memory, bool transfer_halfword>
-void ARM7::ARM_HalfwordDataTransferRegister_Impl(const u32 opcode, const bool sign) {
-    const bool pre_indexing = Common::IsBitSet<24>(opcode);
-    const bool add_offset_to_base = Common::IsBitSet<23>(opcode);
-    const bool write_back = Common::IsBitSet<21>(opcode);
+template <bool pre_indexing, bool add_offset_to_base, bool write_back, bool load_from_memory, bool transfer_halfword, bool sign>
+void ARM7::ARM_HalfwordDataTransferRegister_Impl(const u32 opcode) {
     const std::unsigned_integral auto rn = Common::GetBitRange<19, 16>(opcode);
     const std::unsigned_integral auto rd = Common::GetBitRange<15, 12>(opcode);
     const std::unsigned_integral auto rm = Common::GetBitRange<3, 0>(opcode);
 
     u32 address = GetRegister(rn);
-    if (pre_indexing) {
-        if (add_offset_to_base) {
+    if constexpr (pre_indexing) {
+        if constexpr (add_offset_to_base) {
             address += GetRegister(rm);
         } else {
             address -= GetRegister(rm);
@@ -182,13 +160,13 @@ void ARM7::ARM_HalfwordDataTransferRegister_Impl(const u32 opcode, const bool si
 
         if constexpr (load_from_memory) {
             if constexpr (transfer_halfword) {
-                if (sign) {
+                if constexpr (sign) {
                     SetRegister(rd, (static_cast<s16>(bus.Read16(address)) << 16) >> 16);
                 } else {
                     SetRegister(rd, bus.Read16(address));
                 }
             } else {
-                if (sign) {
+                if constexpr (sign) {
                     SetRegister(rd, (static_cast<s8>(bus.Read8(address)) << 24) >> 24);
                 } else {
                     SetRegister(rd, bus.Read8(address));
@@ -202,19 +180,19 @@ void ARM7::ARM_HalfwordDataTransferRegister_Impl(const u32 opcode, const bool si
             }
         }
 
-        if (write_back) {
+        if constexpr (write_back) {
             SetRegister(rn, address);
         }
     } else {
         if constexpr (load_from_memory) {
             if constexpr (transfer_halfword) {
-                if (sign) {
+                if constexpr (sign) {
                     SetRegister(rd, static_cast<s16>(bus.Read16(address) << 16) >> 16);
                 } else {
                     SetRegister(rd, bus.Read16(address));
                 }
             } else {
-                if (sign) {
+                if constexpr (sign) {
                     SetRegister(rd, static_cast<s8>(bus.Read8(address) << 24) >> 24);
                 } else {
                     SetRegister(rd, bus.Read8(address));
@@ -228,7 +206,7 @@ void ARM7::ARM_HalfwordDataTransferRegister_Impl(const u32 opcode, const bool si
             }
         }
 
-        if (add_offset_to_base) {
+        if constexpr (add_offset_to_base) {
             address += GetRegister(rm);
         } else {
             address -= GetRegister(rm);
@@ -238,42 +216,29 @@ void ARM7::ARM_HalfwordDataTransferRegister_Impl(const u32 opcode, const bool si
     }
 }
 
+template <bool pre_indexing, bool add_offset_to_base, bool write_back, bool load_from_memory, bool sign, bool halfword>
 void ARM7::ARM_HalfwordDataTransferImmediate(const u32 opcode) {
-    const bool load_from_memory = Common::IsBitSet<20>(opcode);
-    const bool sign = Common::IsBitSet<6>(opcode);
-    const bool halfword = Common::IsBitSet<5>(opcode);
-
-    const u8 conditions = (load_from_memory << 1) | halfword;
-    switch (conditions) {
-        case 0b00:
-            ARM_SingleDataSwap(opcode);
-            break;
-        case 0b01:
-            ARM_StoreHalfwordImmediate(opcode, sign);
-            timers.AdvanceCycles(2, Timers::CycleType::Nonsequential);
-            break;
-        case 0b10:
-            // Not to be confused with ARM_LoadByte
-            ARM_LoadSignedByte(opcode);
-            timers.AdvanceCycles(1, Timers::CycleType::Sequential);
-            timers.AdvanceCycles(1, Timers::CycleType::Nonsequential);
-            timers.AdvanceCycles(1, Timers::CycleType::Internal);
-            break;
-        case 0b11:
-            ARM_LoadHalfwordImmediate(opcode, sign);
-            timers.AdvanceCycles(1, Timers::CycleType::Sequential);
-            timers.AdvanceCycles(1, Timers::CycleType::Nonsequential);
-            timers.AdvanceCycles(1, Timers::CycleType::Internal);
-            break;
-        default:
-            UNREACHABLE();
+    if constexpr (!load_from_memory && !halfword) {
+        ARM_SingleDataSwap<false>(opcode);
+    } else if constexpr (!load_from_memory) {
+        ARM_StoreHalfwordImmediate<pre_indexing, add_offset_to_base, write_back, sign>(opcode);
+        AddCycles(2, CycleType::Nonsequential);
+    } else if constexpr (!halfword) {
+        // Not to be confused with ARM_LoadByte
+        ARM_LoadSignedByte<pre_indexing, add_offset_to_base, write_back>(opcode);
+        AddCycles(1, CycleType::Sequential);
+        AddCycles(1, CycleType::Nonsequential);
+        AddCycles(1, CycleType::Internal);
+    } else {
+        ARM_LoadHalfwordImmediate<pre_indexing, add_offset_to_base, write_back, sign>(opcode);
+        AddCycles(1, CycleType::Sequential);
+        AddCycles(1, CycleType::Nonsequential);
+        AddCycles(1, CycleType::Internal);
     }
 }
 
-void ARM7::ARM_LoadHalfwordImmediate(const u32 opcode, const bool sign) {
-    const bool pre_indexing = Common::IsBitSet<24>(opcode);
-    const bool add_offset_to_base = Common::IsBitSet<23>(opcode);
-    const bool write_back = Common::IsBitSet<21>(opcode);
+template <bool pre_indexing, bool add_offset_to_base, bool write_back, bool sign>
+void ARM7::ARM_LoadHalfwordImmediate(const u32 opcode) {
     const std::unsigned_integral auto rn = Common::GetBitRange<19, 16>(opcode);
     const std::unsigned_integral auto rd = Common::GetBitRange<15, 12>(opcode);
     const std::unsigned_integral auto offset_high = Common::GetBitRange<11, 8>(opcode);
@@ -283,8 +248,8 @@ void ARM7::ARM_LoadHalfwordImmediate(const u32 opcode, const bool sign) {
     u32 address = GetRegister(rn);
     bool address_is_halfword_aligned = ((address & 0b1) == 0b0);
 
-    if (pre_indexing) {
-        if (add_offset_to_base) {
+    if constexpr (pre_indexing) {
+        if constexpr (add_offset_to_base) {
             address += offset;
         } else {
             address -= offset;
@@ -292,7 +257,7 @@ void ARM7::ARM_LoadHalfwordImmediate(const u32 opcode, const bool sign) {
 
         address_is_halfword_aligned = ((address & 0b1) == 0b0);
 
-        if (sign) {
+        if constexpr (sign) {
             s16 value = bus.Read16(address & ~0b1);
 
             if (!address_is_halfword_aligned) {
@@ -309,7 +274,7 @@ void ARM7::ARM_LoadHalfwordImmediate(const u32 opcode, const bool sign) {
             SetRegister(rn, address);
         }
     } else {
-        if (sign) {
+        if constexpr (sign) {
             s16 value = bus.Read16(address & ~0b1);
 
             if (!address_is_halfword_aligned) {
@@ -322,7 +287,7 @@ void ARM7::ARM_LoadHalfwordImmediate(const u32 opcode, const bool sign) {
             SetRegister(rd, value);
         }
 
-        if (add_offset_to_base) {
+        if constexpr (add_offset_to_base) {
             address += offset;
         } else {
             address -= offset;
@@ -334,10 +299,8 @@ void ARM7::ARM_LoadHalfwordImmediate(const u32 opcode, const bool sign) {
     }
 }
 
-void ARM7::ARM_StoreHalfwordImmediate(const u32 opcode, const bool sign) {
-    const bool pre_indexing = Common::IsBitSet<24>(opcode);
-    const bool add_offset_to_base = Common::IsBitSet<23>(opcode);
-    const bool write_back = Common::IsBitSet<21>(opcode);
+template <bool pre_indexing, bool add_offset_to_base, bool write_back, bool sign>
+void ARM7::ARM_StoreHalfwordImmediate(const u32 opcode) {
     const std::unsigned_integral auto rn = Common::GetBitRange<19, 16>(opcode);
     const std::unsigned_integral auto rd = Common::GetBitRange<15, 12>(opcode);
     const std::unsigned_integral auto offset_high = Common::GetBitRange<11, 8>(opcode);
@@ -346,8 +309,8 @@ void ARM7::ARM_StoreHalfwordImmediate(const u32 opcode, const bool sign) {
 
     u32 address = GetRegister(rn);
     const u16 value = GetRegister(rd);
-    if (pre_indexing) {
-        if (add_offset_to_base) {
+    if constexpr (pre_indexing) {
+        if constexpr (add_offset_to_base) {
             address += offset;
         } else {
             address -= offset;
@@ -355,12 +318,12 @@ void ARM7::ARM_StoreHalfwordImmediate(const u32 opcode, const bool sign) {
 
         bus.Write16(address, sign ? static_cast<s16>(value) : value);
 
-        if (write_back) {
+        if constexpr (write_back) {
             SetRegister(rn, address);
         }
     } else {
         bus.Write16(address, sign ? static_cast<s16>(value) : value);
-        if (add_offset_to_base) {
+        if constexpr (add_offset_to_base) {
             address += offset;
         } else {
             address -= offset;
@@ -370,10 +333,8 @@ void ARM7::ARM_StoreHalfwordImmediate(const u32 opcode, const bool sign) {
     }
 }
 
+template <bool pre_indexing, bool add_offset_to_base, bool write_back>
 void ARM7::ARM_LoadSignedByte(const u32 opcode) {
-    const bool pre_indexing = Common::IsBitSet<24>(opcode);
-    const bool add_offset_to_base = Common::IsBitSet<23>(opcode);
-    const bool write_back = Common::IsBitSet<21>(opcode);
     const std::unsigned_integral auto rn = Common::GetBitRange<19, 16>(opcode);
     const std::unsigned_integral auto rd = Common::GetBitRange<15, 12>(opcode);
     const std::unsigned_integral auto offset_high = Common::GetBitRange<11, 8>(opcode);
@@ -381,8 +342,8 @@ void ARM7::ARM_LoadSignedByte(const u32 opcode) {
     const s8 offset = (offset_high << 4) | offset_low;
 
     u32 address = GetRegister(rn);
-    if (pre_indexing) {
-        if (add_offset_to_base) {
+    if constexpr (pre_indexing) {
+        if constexpr (add_offset_to_base) {
             address += offset;
         } else {
             address -= offset;
@@ -390,13 +351,13 @@ void ARM7::ARM_LoadSignedByte(const u32 opcode) {
 
         SetRegister(rd, static_cast<s8>(bus.Read8(address)));
 
-        if (write_back) {
+        if constexpr (write_back) {
             SetRegister(rn, address);
         }
     } else {
         SetRegister(rd, static_cast<s8>(bus.Read8(address)));
 
-        if (add_offset_to_base) {
+        if constexpr (add_offset_to_base) {
             address += offset;
         } else {
             address -= offset;
@@ -406,81 +367,53 @@ void ARM7::ARM_LoadSignedByte(const u32 opcode) {
     }
 }
 
+template <bool offset_is_register, bool add_before_transfer, bool add_offset_to_base, bool transfer_byte, bool write_back, bool load_from_memory, ARM7::ShiftType shift_type>
 void ARM7::ARM_SingleDataTransfer(const u32 opcode) {
-    const u16 operation = (opcode >> 20) & 0b101;
-    switch (operation) {
-        case 0b000:
-            // Store word
-            ARM_SingleDataTransfer_Impl<false, false>(opcode);
-            timers.AdvanceCycles(2, Timers::CycleType::Nonsequential);
-            break;
-        case 0b001:
-            // Load word
-            ARM_SingleDataTransfer_Impl<true, false>(opcode);
-            timers.AdvanceCycles(1, Timers::CycleType::Sequential);
-            timers.AdvanceCycles(1, Timers::CycleType::Nonsequential);
-            timers.AdvanceCycles(1, Timers::CycleType::Internal);
-            break;
-        case 0b100:
-            // Store byte
-            ARM_SingleDataTransfer_Impl<false, true>(opcode);
-            timers.AdvanceCycles(2, Timers::CycleType::Nonsequential);
-            break;
-        case 0b101:
-            // Load byte
-            ARM_SingleDataTransfer_Impl<true, true>(opcode);
-            timers.AdvanceCycles(1, Timers::CycleType::Sequential);
-            timers.AdvanceCycles(1, Timers::CycleType::Nonsequential);
-            timers.AdvanceCycles(1, Timers::CycleType::Internal);
-            break;
-        default:
-            UNREACHABLE();
+    ARM_SingleDataTransfer_Impl<offset_is_register, add_before_transfer, add_offset_to_base, write_back, load_from_memory, transfer_byte, shift_type>(opcode);
+
+    if constexpr (load_from_memory) {
+        AddCycles(1, CycleType::Sequential);
+        AddCycles(1, CycleType::Nonsequential);
+        AddCycles(1, CycleType::Internal);
+    } else {
+        AddCycles(2, CycleType::Nonsequential);
     }
 }
 
-template <bool load_from_memory, bool transfer_byte>
+template <bool offset_is_register, bool add_before_transfer, bool add_offset_to_base, bool write_back, bool load_from_memory, bool transfer_byte, ARM7::ShiftType shift_type>
 void ARM7::ARM_SingleDataTransfer_Impl(const u32 opcode) {
-    const bool offset_is_register = Common::IsBitSet<25>(opcode);
-    const bool add_before_transfer = Common::IsBitSet<24>(opcode);
-    const bool add_offset_to_base = Common::IsBitSet<23>(opcode);
-    const bool write_back = Common::IsBitSet<21>(opcode);
     const std::unsigned_integral auto rn = Common::GetBitRange<19, 16>(opcode);
     const std::unsigned_integral auto rd = Common::GetBitRange<15, 12>(opcode);
     s32 offset = 0;
 
-    if (offset_is_register) {
-        const std::unsigned_integral auto shift = Common::GetBitRange<11, 4>(opcode);
+    if constexpr (offset_is_register) {
         const std::unsigned_integral auto rm = Common::GetBitRange<3, 0>(opcode);
+        std::unsigned_integral auto shift_amount = Common::GetBitRange<11, 7>(opcode);
 
-        if (!Common::IsBitSet<0>(shift)) {
-            std::unsigned_integral auto shift_amount = Common::GetBitRange<7, 3>(shift);
-            auto shift_type = ShiftType(Common::GetBitRange<2, 1>(shift));
-
-            if (shift_amount == 0 && shift_type != ShiftType::LSL) {
-                if (shift_type == ShiftType::ROR) {
-                    shift_type = ShiftType::RRX;
-                } else {
-                    shift_amount = 32;
-                }
-            }
-
-            if (shift_type == ShiftType::RRX) {
+        if constexpr (shift_type == ShiftType::ROR) {
+            // ROR #0 is used to encode RRX.
+            if (shift_amount == 0) {
                 offset = Shift_RRX(GetRegister(rm), false);
             } else {
-                offset = Shift(GetRegister(rm), shift_type, shift_amount, false);
+                offset = Shift<ShiftType::ROR>(GetRegister(rm), shift_amount, false);
             }
-        } else if ((shift & 0b1001) == 0b0001) {
-            UNIMPLEMENTED();
         } else {
-            ASSERT(false);
+            // LSR #0 and ASR #0 are used to encode shifts by 32.
+            if constexpr (shift_type != ShiftType::LSL) {
+                if (shift_amount == 0) {
+                    shift_amount = 32;
+                }
+            }
+
+            offset = Shift<shift_type>(GetRegister(rm), shift_amount, false);
         }
     } else {
         offset = Common::GetBitRange<11, 0>(opcode);
     }
 
     u32 address = GetRegister(rn);
-    if (add_before_transfer) {
-        if (add_offset_to_base) {
+    if constexpr (add_before_transfer) {
+        if constexpr (add_offset_to_base) {
             address += offset;
         } else {
             address -= offset;
@@ -520,7 +453,7 @@ void ARM7::ARM_SingleDataTransfer_Impl(const u32 opcode) {
             }
         }
 
-        if (add_offset_to_base) {
+        if constexpr (add_offset_to_base) {
             address += offset;
         } else {
             address -= offset;
@@ -532,16 +465,12 @@ void ARM7::ARM_SingleDataTransfer_Impl(const u32 opcode) {
     }
 }
 
+template <bool pre_indexing, bool add_offset_to_base, bool load_psr, bool write_back, bool load_from_memory>
 void ARM7::ARM_BlockDataTransfer(const u32 opcode) {
-    const bool pre_indexing = Common::IsBitSet<24>(opcode);
-    const bool add_offset_to_base = Common::IsBitSet<23>(opcode);
-    const bool load_psr = Common::IsBitSet<22>(opcode);
-    const bool write_back = Common::IsBitSet<21>(opcode);
-    const bool load_from_memory = Common::IsBitSet<20>(opcode);
     const std::unsigned_integral auto rn = Common::GetBitRange<19, 16>(opcode);
     const std::unsigned_integral auto rlist = Common::GetBitRange<15, 0>(opcode);
 
-    if (load_psr) {
+    if constexpr (load_psr) {
         LERROR("unimplemented load PSR in block data transfer");
     }
 
@@ -559,17 +488,17 @@ void ARM7::ARM_BlockDataTransfer(const u32 opcode) {
     }
 
     const auto n = set_bits.size();
-    timers.AdvanceCycles(n, Timers::CycleType::Sequential);
-    timers.AdvanceCycles(1, Timers::CycleType::Nonsequential);
-    timers.AdvanceCycles(1, Timers::CycleType::Internal);
+    AddCycles(n, CycleType::Sequential);
+    AddCycles(1, CycleType::Nonsequential);
+    AddCycles(1, CycleType::Internal);
 
     const bool rn_is_in_rlist = std::find(set_bits.begin(), set_bits.end(), rn) != set_bits.end();
 
     u32 address = GetRegister(rn);
-    if (load_from_memory) {
-        if (add_offset_to_base) {
+    if constexpr (load_from_memory) {
+        if constexpr (add_offset_to_base) {
             for (u8 reg : set_bits) {
-                if (pre_indexing) {
+                if constexpr (pre_indexing) {
                     address += 4;
                     SetRegister(reg, bus.Read32(address));
                 } else {
@@ -579,7 +508,7 @@ void ARM7::ARM_BlockDataTransfer(const u32 opcode) {
             }
         } else {
             for (u8 reg : set_bits | ranges::views::reverse) {
-                if (pre_indexing) {
+                if constexpr (pre_indexing) {
                     address -= 4;
                     SetRegister(reg, bus.Read32(address));
                 } else {
@@ -589,9 +518,9 @@ void ARM7::ARM_BlockDataTransfer(const u32 opcode) {
             }
         }
     } else {
-        if (add_offset_to_base) {
+        if constexpr (add_offset_to_base) {
             for (u8 reg : set_bits) {
-                if (pre_indexing) {
+                if constexpr (pre_indexing) {
                     address += 4;
                     bus.Write32(address, GetRegister(reg));
                 } else {
@@ -601,7 +530,7 @@ void ARM7::ARM_BlockDataTransfer(const u32 opcode) {
             }
         } else {
             for (u8 reg : set_bits | ranges::views::reverse) {
-                if (pre_indexing) {
+                if constexpr (pre_indexing) {
                     address -= 4;
                     bus.Write32(address, GetRegister(reg));
                 } else {
@@ -612,7 +541,7 @@ void ARM7::ARM_BlockDataTransfer(const u32 opcode) {
         }
     }
 
-    if (write_back) {
+    if constexpr (write_back) {
         if (load_from_memory && rn_is_in_rlist) {
             return;
         }
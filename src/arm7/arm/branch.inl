@@ -1,3 +1,5 @@
+#pragma once
+
 #include "common/bits.h"
 #include "arm7/arm7.h"
 
@@ -10,39 +12,45 @@ void ARM7::ARM_BranchAndExchange(const u32 opcode) {
 
     SetPC(GetRegister(rn) & ~0b1);
 
-    timers.AdvanceCycles(2, Timers::CycleType::Sequential);
-    timers.AdvanceCycles(1, Timers::CycleType::Nonsequential);
+    AddCycles(2, CycleType::Sequential);
+    AddCycles(1, CycleType::Nonsequential);
 }
 
+template <bool link>
 void ARM7::ARM_Branch(const u32 opcode) {
-    const bool link = Common::IsBitSet<24>(opcode);
     s32 offset = (Common::GetBitRange<23, 0>(opcode)) << 2;
 
     offset <<= 6;
     offset >>= 6;
 
-    if (link) {
+    if constexpr (link) {
         SetLR(GetPC() - 4);
     }
 
-    SetPC(GetPC() + offset);
+    const u32 branch_address = GetPC() - 8;
+    const u32 target = GetPC() + offset;
+    SetPC(target);
+
+    if constexpr (!link) {
+        DetectIdleLoop(branch_address, target);
+    }
 
-    timers.AdvanceCycles(2, Timers::CycleType::Sequential);
-    timers.AdvanceCycles(1, Timers::CycleType::Nonsequential);
+    AddCycles(2, CycleType::Sequential);
+    AddCycles(1, CycleType::Nonsequential);
 }
 
 void ARM7::ARM_SoftwareInterrupt([[maybe_unused]] const u32 opcode) {
     LDEBUG("ARM-mode SWI at {:08X}", GetPC() - 8);
 
     u32 lr = GetPC() - 4;
-    u32 old_cpsr = cpsr.raw;
+    u32 old_cpsr = GetCPSR();
 
-    cpsr.flags.processor_mode = ProcessorMode::Supervisor;
+    SetProcessorMode(ProcessorMode::Supervisor);
     SetLR(lr);
-    cpsr.flags.irq_disabled = true;
+    SetIRQsDisabled(true);
     SetPC(0x00000008);
     SetSPSR(old_cpsr);
 
-    timers.AdvanceCycles(2, Timers::CycleType::Sequential);
-    timers.AdvanceCycles(1, Timers::CycleType::Nonsequential);
+    AddCycles(2, CycleType::Sequential);
+    AddCycles(1, CycleType::Nonsequential);
 }
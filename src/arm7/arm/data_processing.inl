@@ -1,40 +1,25 @@
+#pragma once
+
 #include "common/bits.h"
 #include "arm7/arm7.h"
 
+template <bool op2_is_immediate, u8 op, bool set_condition_codes, bool shift_by_register, ARM7::ShiftType shift_type>
 void ARM7::ARM_DataProcessing(const u32 opcode) {
-    if ((opcode & 0x0FBF0FFF) == 0x010F0000) {
-        ARM_MRS(opcode);
-        return;
-    }
-
-    if ((opcode & 0x0DBFF000) == 0x0129F000) {
-        ARM_MSR<false>(opcode);
-        return;
-    }
-
-    if ((opcode & 0x0DBFF000) == 0x0128F000) {
-        ARM_MSR<true>(opcode);
-        return;
-    }
-
-    const bool op2_is_immediate = Common::IsBitSet<25>(opcode);
-    const std::unsigned_integral auto op = Common::GetBitRange<24, 21>(opcode);
-    const bool set_condition_codes = Common::IsBitSet<20>(opcode);
     const std::unsigned_integral auto rn = Common::GetBitRange<19, 16>(opcode);
     const std::unsigned_integral auto rd = Common::GetBitRange<15, 12>(opcode);
     const std::unsigned_integral auto op2 = Common::GetBitRange<11, 0>(opcode);
 
-    timers.AdvanceCycles(1, Timers::CycleType::Sequential);
+    AddCycles(1, CycleType::Sequential);
 
     if (rd == 15) {
-        timers.AdvanceCycles(1, Timers::CycleType::Sequential);
-        timers.AdvanceCycles(1, Timers::CycleType::Nonsequential);
+        AddCycles(1, CycleType::Sequential);
+        AddCycles(1, CycleType::Nonsequential);
     }
 
-    if (op2_is_immediate) {
+    if constexpr (op2_is_immediate) {
         const std::unsigned_integral auto rotate_amount = Common::GetBitRange<11, 8>(op2);
         const std::unsigned_integral auto imm = Common::GetBitRange<7, 0>(op2);
-        const bool old_carry_flag = cpsr.flags.carry;
+        const bool old_carry_flag = GetCarry();
         const u32 rotated_operand = Shift_RotateRight(imm, rotate_amount << 1, set_condition_codes);
 
         switch (op) {
@@ -47,7 +32,7 @@ void ARM7::ARM_DataProcessing(const u32 opcode) {
             case 0x2:
                 SetRegister(rd, SUB(GetRegister(rn), rotated_operand, set_condition_codes));
                 if (set_condition_codes && rd == 15) {
-                    cpsr.raw = GetSPSR();
+                    SetCPSR(GetSPSR());
                 }
                 break;
             case 0x3:
@@ -57,7 +42,7 @@ void ARM7::ARM_DataProcessing(const u32 opcode) {
                 SetRegister(rd, ADD(GetRegister(rn), rotated_operand, set_condition_codes));
                 break;
             case 0x5:
-                cpsr.flags.carry = old_carry_flag;
+                SetCarry(old_carry_flag);
                 SetRegister(rd, ADC(GetRegister(rn), rotated_operand, set_condition_codes));
                 break;
             case 0x6:
@@ -83,7 +68,7 @@ void ARM7::ARM_DataProcessing(const u32 opcode) {
                 break;
             case 0xD:
                 if (set_condition_codes && rd == 15) {
-                    cpsr.raw = GetSPSR();
+                    SetCPSR(GetSPSR());
                 }
 
                 SetRegister(rd, rotated_operand);
@@ -103,25 +88,27 @@ void ARM7::ARM_DataProcessing(const u32 opcode) {
             SetPC(GetPC() - 4);
         }
     } else {
-        const std::unsigned_integral auto shift = Common::GetBitRange<11, 4>(op2);
         const std::unsigned_integral auto rm = Common::GetBitRange<3, 0>(op2);
-        if (!Common::IsBitSet<0>(shift)) {
-            std::unsigned_integral auto shift_amount = Common::GetBitRange<7, 3>(shift);
-            auto shift_type = ShiftType(Common::GetBitRange<2, 1>(shift));
+        if constexpr (!shift_by_register) {
+            std::unsigned_integral auto shift_amount = Common::GetBitRange<11, 7>(op2);
 
-            if (shift_amount == 0 && shift_type != ShiftType::LSL) {
-                if (shift_type == ShiftType::ROR) {
-                    shift_type = ShiftType::RRX;
+            u32 shifted_operand = 0;
+            if constexpr (shift_type == ShiftType::ROR) {
+                // ROR #0 is used to encode RRX.
+                if (shift_amount == 0) {
+                    shifted_operand = Shift_RRX(GetRegister(rm), set_condition_codes);
                 } else {
-                    shift_amount = 32;
+                    shifted_operand = Shift<ShiftType::ROR>(GetRegister(rm), shift_amount, set_condition_codes);
                 }
-            }
-
-            u32 shifted_operand = 0;
-            if (shift_type == ShiftType::RRX) {
-                shifted_operand = Shift_RRX(GetRegister(rm), set_condition_codes);
             } else {
-                shifted_operand = Shift(GetRegister(rm), shift_type, shift_amount, set_condition_codes);
+                // LSR #0 and ASR #0 are used to encode shifts by 32.
+                if constexpr (shift_type != ShiftType::LSL) {
+                    if (shift_amount == 0) {
+                        shift_amount = 32;
+                    }
+                }
+
+                shifted_operand = Shift<shift_type>(GetRegister(rm), shift_amount, set_condition_codes);
             }
 
             switch (op) {
@@ -166,7 +153,7 @@ void ARM7::ARM_DataProcessing(const u32 opcode) {
                     break;
                 case 0xD:
                     if (set_condition_codes && rd == 15) {
-                        cpsr.raw = GetSPSR();
+                        SetCPSR(GetSPSR());
                     }
 
                     SetRegister(rd, shifted_operand);
@@ -180,16 +167,14 @@ void ARM7::ARM_DataProcessing(const u32 opcode) {
                 default:
                     UNREACHABLE();
             }
-        } else if (!Common::IsBitSet<3>(shift) && Common::IsBitSet<0>(shift)) {
-            timers.AdvanceCycles(1, Timers::CycleType::Internal);
+        } else {
+            AddCycles(1, CycleType::Internal);
 
             // If a register is used to specify the shift amount the PC will be 12 bytes ahead.
             gpr[15] += 4;
 
-            const std::unsigned_integral auto rs = Common::GetBitRange<7, 4>(shift);
-            const auto shift_type = ShiftType(Common::GetBitRange<2, 1>(shift));
-
-            const u32 shifted_operand = Shift(GetRegister(rm), shift_type, GetRegister(rs), set_condition_codes);
+            const std::unsigned_integral auto rs = Common::GetBitRange<11, 8>(op2);
+            const u32 shifted_operand = Shift<shift_type>(GetRegister(rm), GetRegister(rs), set_condition_codes);
 
             gpr[15] -= 4;
 
@@ -221,7 +206,7 @@ void ARM7::ARM_DataProcessing(const u32 opcode) {
                     break;
                 case 0xD:
                     if (set_condition_codes && rd == 15) {
-                        cpsr.raw = GetSPSR();
+                        SetCPSR(GetSPSR());
                     }
 
                     SetRegister(rd, shifted_operand);
@@ -239,14 +224,11 @@ void ARM7::ARM_DataProcessing(const u32 opcode) {
             if (rn == 15) {
                 gpr[15] -= 4;
             }
-        } else {
-            ASSERT(false);
         }
     }
 
     if (set_condition_codes && rd != 15) {
-        cpsr.flags.negative = Common::IsBitSet<31>(GetRegister(rd));
-        cpsr.flags.zero = (GetRegister(rd) == 0);
+        SetNZ(Common::IsBitSet<31>(GetRegister(rd)), GetRegister(rd) == 0);
     }
 }
 
@@ -258,57 +240,63 @@ void ARM7::ARM_DataProcessing(const u32 opcode) {
 // "msr won't be the only way to set a PSR. There's mode changes and PSR transfers
 // in block/single data transfers, CPU exceptions and some data processing instructions."
 
+template <bool source_is_spsr>
 void ARM7::ARM_MRS(const u32 opcode) {
-    const bool source_is_spsr = Common::IsBitSet<22>(opcode);
     const std::unsigned_integral auto rd = Common::GetBitRange<15, 12>(opcode);
 
-    if (source_is_spsr) {
+    if constexpr (source_is_spsr) {
         SetRegister(rd, GetSPSR());
     } else {
         SetRegister(rd, GetCPSR());
     }
 }
 
-template <bool flag_bits_only>
+template <bool operand_is_immediate, bool destination_is_spsr>
 void ARM7::ARM_MSR(const u32 opcode) {
-    const bool destination_is_spsr = Common::IsBitSet<22>(opcode);
-    const bool operand_is_immediate = Common::IsBitSet<25>(opcode);
+    // Bit 16 selects whether the control field is written as well as the flags.
+    if (Common::IsBitSet<16>(opcode)) {
+        ARM_MSR_Impl<operand_is_immediate, destination_is_spsr, false>(opcode);
+    } else {
+        ARM_MSR_Impl<operand_is_immediate, destination_is_spsr, true>(opcode);
+    }
+}
+
+template <bool operand_is_immediate, bool destination_is_spsr, bool flag_bits_only>
+void ARM7::ARM_MSR_Impl(const u32 opcode) {
     const std::unsigned_integral auto source_operand = Common::GetBitRange<11, 0>(opcode);
 
-    if (operand_is_immediate) {
+    if constexpr (operand_is_immediate) {
         const std::unsigned_integral auto rotate_amount = Common::GetBitRange<11, 8>(source_operand);
         const std::unsigned_integral auto immediate = Common::GetBitRange<7, 0>(source_operand);
 
         if constexpr (flag_bits_only) {
-            if (destination_is_spsr) {
+            if constexpr (destination_is_spsr) {
                 SetSPSR(GetSPSR() & ~0xFFFFFF00);
                 SetSPSR(GetSPSR() | (Shift_RotateRight(immediate, rotate_amount << 1, false) & 0xFFFFFF00));
             } else {
-                cpsr.raw &= ~0xFFFFFF00;
-                cpsr.raw |= (Shift_RotateRight(immediate, rotate_amount << 1, false) & 0xFFFFFF00);
+                SetCPSR((GetCPSR() & ~0xFFFFFF00) | (Shift_RotateRight(immediate, rotate_amount << 1, false) & 0xFFFFFF00));
             }
         } else {
-            if (destination_is_spsr) {
+            if constexpr (destination_is_spsr) {
                 SetSPSR(Shift_RotateRight(immediate, rotate_amount << 1, false));
             } else {
-                cpsr.raw = Shift_RotateRight(immediate, rotate_amount << 1, false);
+                SetCPSR(Shift_RotateRight(immediate, rotate_amount << 1, false));
             }
         }
     } else {
         const std::unsigned_integral auto rm = Common::GetBitRange<3, 0>(source_operand);
         if constexpr (flag_bits_only) {
-            if (destination_is_spsr) {
+            if constexpr (destination_is_spsr) {
                 SetSPSR(GetSPSR() & ~0xFFFFFF00);
                 SetSPSR(GetSPSR() | (GetRegister(rm) & 0xFFFFFF00));
             } else {
-                cpsr.raw &= ~0xFFFFFF00;
-                cpsr.raw |= (GetRegister(rm) & 0xFFFFFF00);
+                SetCPSR((GetCPSR() & ~0xFFFFFF00) | (GetRegister(rm) & 0xFFFFFF00));
             }
         } else {
-            if (destination_is_spsr) {
+            if constexpr (destination_is_spsr) {
                 SetSPSR(GetRegister(rm));
             } else {
-                cpsr.raw = GetRegister(rm);
+                SetCPSR(GetRegister(rm));
             }
         }
     }
@@ -1,32 +1,93 @@
+#include <algorithm>
 #include <bit>
 #include "arm7.h"
 #include "common/bits.h"
 #include "common/logging.h"
 
-ARM7::ARM7(Bus& bus_, Timers& timers_)
-    : bus(bus_), timers(timers_) {
-    GenerateThumbLUT();
+#include "arm/arm.inl"
+#include "arm/branch.inl"
+#include "arm/data_processing.inl"
+#include "thumb/branch.inl"
+#include "thumb/thumb.inl"
 
+#ifdef HA_JIT_X64
+#include "jit_x64.h"
+#endif
+
+ARM7::ARM7(Bus& bus_, Scheduler& scheduler_)
+    : bus(bus_), interrupts(bus_.GetInterrupts()), scheduler(scheduler_) {
     // Initialize registers
-    cpsr.flags.processor_mode = ProcessorMode::Supervisor;
+    cpsr.flags.processor_mode = ProcessorMode::System;
+    SetProcessorMode(ProcessorMode::Supervisor);
     SetPC(0x00000000);
 }
 
-void ARM7::HandleInterrupts() {
-    if (cpsr.flags.irq_disabled) {
-        return;
+ARM7::~ARM7() = default;
+
+void ARM7::EnableJIT() {
+#ifdef HA_JIT_X64
+    jit = std::make_unique<JIT>(*this);
+    if (!jit->IsAvailable()) {
+        LWARN("failed to allocate memory for the JIT, falling back to the interpreter");
+        jit.reset();
     }
+#else
+    LWARN("the JIT isn't supported on this host, falling back to the interpreter");
+#endif
+}
 
-    if (!bus.GetInterrupts().GetIME()) {
+void ARM7::SetProcessorMode(const ProcessorMode new_mode) {
+    const ProcessorMode old_mode = cpsr.flags.processor_mode;
+    if (new_mode == old_mode) {
         return;
     }
 
-    const u16 ie_reg = bus.GetInterrupts().GetIE();
-    const u16 if_reg = bus.GetInterrupts().GetIF();
-    if ((if_reg & ie_reg) == 0) {
-        return;
+    // Bank the outgoing mode's registers...
+    if (old_mode == ProcessorMode::FIQ) {
+        std::copy_n(gpr.begin() + 8, fiq_r.size(), fiq_r.begin());
+        std::copy(non_fiq_r.begin(), non_fiq_r.end(), gpr.begin() + 8);
+    } else {
+        std::copy_n(gpr.begin() + 13, 2, GetBankedRegisters(old_mode).begin());
+    }
+
+    // ...and swap in the incoming mode's.
+    if (new_mode == ProcessorMode::FIQ) {
+        std::copy_n(gpr.begin() + 8, non_fiq_r.size(), non_fiq_r.begin());
+        std::copy(fiq_r.begin(), fiq_r.end(), gpr.begin() + 8);
+    } else {
+        const std::array<u32, 2>& banked_registers = GetBankedRegisters(new_mode);
+        std::copy(banked_registers.begin(), banked_registers.end(), gpr.begin() + 13);
     }
 
+    cpsr.flags.processor_mode = new_mode;
+}
+
+void ARM7::SetCPSR(const u32 value) {
+    SetProcessorMode(ProcessorMode(Common::GetBitRange<4, 0>(value)));
+    cpsr.raw = value & ~CPSR_FLAGS_MASK;
+    nzcv = value >> 28;
+    interrupts.SetCPUIRQsDisabled(cpsr.flags.irq_disabled);
+}
+
+std::array<u32, 2>& ARM7::GetBankedRegisters(const ProcessorMode mode) {
+    switch (mode) {
+        case ProcessorMode::System:
+        case ProcessorMode::User:
+            return usr_r;
+        case ProcessorMode::Supervisor:
+            return svc_r;
+        case ProcessorMode::Abort:
+            return abt_r;
+        case ProcessorMode::IRQ:
+            return irq_r;
+        case ProcessorMode::Undefined:
+            return und_r;
+        default:
+            UNREACHABLE_MSG("invalid ARM7 processor mode 0x{:X}", Common::GetUnderlyingValue(mode));
+    }
+}
+
+void ARM7::HandleAssertedIRQLine() {
     halted = false;
 
     if (!started_ime_delay) {
@@ -41,12 +102,12 @@ void ARM7::HandleInterrupts() {
 
     // FIXME: this doesn't seem right.
     const u32 lr = GetPC() + (cpsr.flags.thumb_mode ? 2 : 0); // - (cpsr.flags.thumb_mode ? 2 : 4);
-    const u32 old_cpsr = cpsr.raw;
+    const u32 old_cpsr = GetCPSR();
 
-    cpsr.flags.processor_mode = ProcessorMode::IRQ;
+    SetProcessorMode(ProcessorMode::IRQ);
     SetLR(lr);
     cpsr.flags.thumb_mode = false;
-    cpsr.flags.irq_disabled = true;
+    SetIRQsDisabled(true);
     SetPC(0x00000018);
     SetSPSR(old_cpsr);
 
@@ -54,11 +115,134 @@ void ARM7::HandleInterrupts() {
     ime_delay = 2;
 }
 
+void ARM7::RunUntil(const u64 timestamp) {
+    while (scheduler.GetCurrentTimestamp() < timestamp) {
+        // Instructions can schedule events that are due before the timeslice ends (e.g. DMA).
+        const u64 deadline = std::min(timestamp, scheduler.GetNextEventTimestamp());
+        if (scheduler.GetCurrentTimestamp() >= deadline) {
+            return;
+        }
+
+        CachedBlock* block = halted ? nullptr : GetBlock();
+        if (block) {
+            ExecuteBlock(*block, deadline);
+        } else {
+            Step(false);
+        }
+
+        // Nothing but a scheduled event can wake us up or get us out of an idle loop,
+        // so skip straight to the end of the timeslice.
+        if (halted || idle_loop_detected) {
+            idle_loop_detected = false;
+
+            const u64 now = scheduler.GetCurrentTimestamp();
+            const u64 wake_up_timestamp = std::min(timestamp, scheduler.GetNextEventTimestamp());
+            if (now < wake_up_timestamp) {
+                scheduler.AddCycles(wake_up_timestamp - now);
+            }
+
+            return;
+        }
+    }
+}
+
+ARM7::CachedBlock* ARM7::GetBlock() {
+    const bool thumb_mode = cpsr.flags.thumb_mode;
+    const u32 address = gpr[15] - (thumb_mode ? 2 : 4);
+    if (!IsCacheable(address)) {
+        return nullptr;
+    }
+
+    CachedBlock& block = block_cache[address | thumb_mode];
+    if (block.instructions.empty() || (block.in_wram && block.generation != wram_page_generations[block.wram_page])) {
+        CompileBlock(block, address, thumb_mode);
+    }
+
+    return &block;
+}
+
+void ARM7::ExecuteBlock(CachedBlock& block, const u64 timestamp) {
+#ifdef HA_JIT_X64
+    if (jit) {
+        jit->ExecuteBlock(block, timestamp);
+        return;
+    }
+#endif
+
+    const u32 instruction_size = block.thumb_mode ? 2 : 4;
+    exit_block = false;
+
+    for (const CachedInstruction& instruction : block.instructions) {
+        // This is Step() without the fetch and decode.
+        const u32 next_pc = gpr[15];
+        HandleInterrupts();
+        if (gpr[15] != next_pc) {
+            // An interrupt was taken, which refilled the pipeline.
+            return;
+        }
+
+        gpr[15] += instruction_size;
+        const u32 pc = gpr[15];
+
+        if (block.thumb_mode) {
+            (this->*instruction.handler.thumb)(instruction.opcode);
+        } else if (instruction.condition == 0xE || CheckConditionCode(instruction.condition)) {
+            (this->*instruction.handler.arm)(instruction.opcode);
+        }
+
+        if (gpr[15] != pc) {
+            // The instruction wrote to R15, which refilled the pipeline.
+            return;
+        }
+
+        if (halted || idle_loop_detected || exit_block || cpsr.flags.thumb_mode != block.thumb_mode ||
+            scheduler.GetCurrentTimestamp() >= timestamp) {
+            break;
+        }
+    }
+
+    // Leave the pipeline the way Step() expects to find it.
+    SetPC(GetPC() - (cpsr.flags.thumb_mode ? 2 : 4));
+}
+
+void ARM7::DetectIdleLoop(const u32 branch_address, const u32 target) {
+    // An interrupt is about to be taken, which will break out of the loop.
+    if (started_ime_delay) {
+        return;
+    }
+
+    if (target > branch_address || (branch_address - target) > MAX_IDLE_LOOP_LENGTH) {
+        return;
+    }
+
+    if (known_idle_loop_address == target) {
+        idle_loop_detected = true;
+        return;
+    }
+
+    const u64 bus_write_count = bus.GetWriteCount();
+    const u64 bus_volatile_read_count = bus.GetVolatileReadCount();
+    if (idle_loop_snapshot.target == target &&
+        idle_loop_snapshot.bus_write_count == bus_write_count &&
+        idle_loop_snapshot.bus_volatile_read_count == bus_volatile_read_count &&
+        idle_loop_snapshot.cpsr == GetCPSR() &&
+        std::equal(idle_loop_snapshot.gpr.begin(), idle_loop_snapshot.gpr.end(), gpr.begin())) {
+        idle_loop_detected = true;
+        return;
+    }
+
+    idle_loop_snapshot.target = target;
+    idle_loop_snapshot.bus_write_count = bus_write_count;
+    idle_loop_snapshot.bus_volatile_read_count = bus_volatile_read_count;
+    idle_loop_snapshot.cpsr = GetCPSR();
+    std::copy_n(gpr.begin(), idle_loop_snapshot.gpr.size(), idle_loop_snapshot.gpr.begin());
+}
+
 void ARM7::Step(bool dump_registers) {
     HandleInterrupts();
 
     if (halted) {
-        timers.AdvanceCycles(1, Timers::CycleType::None);
+        AddCycles(1, CycleType::Internal);
         return;
     }
 
@@ -68,26 +252,25 @@ void ARM7::Step(bool dump_registers) {
 
         pipeline[0] = pipeline[1];
         gpr[15] += 2;
-        pipeline[1] = bus.Read16(gpr[15]);
+        pipeline[1] = Fetch<u16>(gpr[15]);
 
-        const Thumb_Instructions instr = DecodeThumbInstruction(opcode);
         if (dump_registers)
             DumpRegisters();
-        // DisassembleThumbInstruction(instr, opcode);
-        ExecuteThumbInstruction(instr, opcode);
+
+        // DisassembleThumbInstruction(DecodeThumbInstruction(opcode), opcode);
+        ExecuteThumbInstruction(opcode);
     } else {
         const u32 opcode = pipeline[0];
 
         pipeline[0] = pipeline[1];
         gpr[15] += 4;
-        pipeline[1] = bus.Read32(gpr[15]);
+        pipeline[1] = Fetch<u32>(gpr[15]);
 
-        const ARM_Instructions instr = DecodeARMInstruction(opcode);
         if (dump_registers)
             DumpRegisters();
 
-        // DisassembleARMInstruction(instr, opcode);
-        ExecuteARMInstruction(instr, opcode);
+        // DisassembleARMInstruction(DecodeARMInstruction(opcode), opcode);
+        ExecuteARMInstruction(opcode);
     }
 }
 
@@ -112,153 +295,248 @@ ARM7::ARM_Instructions ARM7::DecodeARMInstruction(const u32 opcode) const {
     return ARM_Instructions::Unknown;
 }
 
-void ARM7::ExecuteARMInstruction(const ARM_Instructions instr, const u32 opcode) {
+void ARM7::ExecuteARMInstruction(const u32 opcode) {
     const std::unsigned_integral auto cond = Common::GetBitRange<31, 28>(opcode);
     if (!CheckConditionCode(cond)) {
         return;
     }
 
-    switch (instr) {
-        case ARM_Instructions::DataProcessing:
-            ARM_DataProcessing(opcode);
-            break;
-        case ARM_Instructions::Multiply:
-            ARM_Multiply(opcode);
-            break;
-        case ARM_Instructions::MultiplyLong:
-            ARM_MultiplyLong(opcode);
-            break;
-        case ARM_Instructions::SingleDataSwap:
-            ARM_SingleDataSwap(opcode);
-            break;
-        case ARM_Instructions::BranchAndExchange:
-            ARM_BranchAndExchange(opcode);
-            break;
-        case ARM_Instructions::HalfwordDataTransferRegister:
-            ARM_HalfwordDataTransferRegister(opcode);
-            break;
-        case ARM_Instructions::HalfwordDataTransferImmediate:
-            ARM_HalfwordDataTransferImmediate(opcode);
-            break;
-        case ARM_Instructions::SingleDataTransfer:
-            ARM_SingleDataTransfer(opcode);
-            break;
-        case ARM_Instructions::BlockDataTransfer:
-            ARM_BlockDataTransfer(opcode);
-            break;
-        case ARM_Instructions::Branch:
-            ARM_Branch(opcode);
-            break;
-        case ARM_Instructions::SoftwareInterrupt:
-            ARM_SoftwareInterrupt(opcode);
-            break;
+    (this->*arm_lut[GetARMLUTIndex(opcode)])(opcode);
+}
 
-        case ARM_Instructions::Unknown:
-        default:
-            UNIMPLEMENTED_MSG("interpreter: unimplemented ARM instruction ({})", Common::GetUnderlyingValue(instr));
-    }
+void ARM7::ARM_UnknownInstruction(const u32 opcode) {
+    UNIMPLEMENTED_MSG("interpreter: unimplemented ARM instruction (opcode: {:08X}, pc: {:08X})", opcode, GetPC() - 8);
 }
 
 template <std::size_t I>
-consteval ARM7::Thumb_Instructions ARM7::GenerateThumbLUT_Impl() {
-    if ((I & 0xF0) == 0xF0) return Thumb_Instructions::LongBranchWithLink;
-    if ((I & 0xF8) == 0xE0) return Thumb_Instructions::UnconditionalBranch;
-    if ((I & 0xFF) == 0xDF) return Thumb_Instructions::SoftwareInterrupt;
-    if ((I & 0xF0) == 0xD0) return Thumb_Instructions::ConditionalBranch;
-    if ((I & 0xF0) == 0xC0) return Thumb_Instructions::MultipleLoadStore;
-    if ((I & 0xF6) == 0xB4) return Thumb_Instructions::PushPopRegisters;
-    if ((I & 0xFF) == 0xB0) return Thumb_Instructions::AddOffsetToStackPointer;
-    if ((I & 0xF0) == 0xA0) return Thumb_Instructions::LoadAddress;
-    if ((I & 0xF0) == 0x90) return Thumb_Instructions::SPRelativeLoadStore;
-    if ((I & 0xF0) == 0x80) return Thumb_Instructions::LoadStoreHalfword;
-    if ((I & 0xE0) == 0x60) return Thumb_Instructions::LoadStoreWithImmediateOffset;
-    if ((I & 0xF2) == 0x52) return Thumb_Instructions::LoadStoreSignExtendedByteHalfword;
-    if ((I & 0xF2) == 0x50) return Thumb_Instructions::LoadStoreWithRegisterOffset;
-    if ((I & 0xF8) == 0x48) return Thumb_Instructions::PCRelativeLoad;
-    if ((I & 0xFC) == 0x44) return Thumb_Instructions::HiRegisterOperationsBranchExchange;
-    if ((I & 0xFC) == 0x40) return Thumb_Instructions::ALUOperations;
-    if ((I & 0xE0) == 0x20) return Thumb_Instructions::MoveCompareAddSubtractImmediate;
-    if ((I & 0xF8) == 0x18) return Thumb_Instructions::AddSubtract;
-    if ((I & 0xE0) == 0x00) return Thumb_Instructions::MoveShiftedRegister;
+consteval ARM7::ARMHandler ARM7::GenerateARMLUT_Impl() {
+    // Put the index bits back where they are in the opcode.
+    constexpr u32 opcode = ((I & 0xFF0) << 16) | ((I & 0xF) << 4);
+
+    constexpr bool bit25 = Common::IsBitSet<25>(opcode);
+    constexpr bool bit24 = Common::IsBitSet<24>(opcode);
+    constexpr bool bit23 = Common::IsBitSet<23>(opcode);
+    constexpr bool bit22 = Common::IsBitSet<22>(opcode);
+    constexpr bool bit21 = Common::IsBitSet<21>(opcode);
+    constexpr bool bit20 = Common::IsBitSet<20>(opcode);
+    constexpr bool bit6 = Common::IsBitSet<6>(opcode);
+    constexpr bool bit5 = Common::IsBitSet<5>(opcode);
+    constexpr bool bit4 = Common::IsBitSet<4>(opcode);
+    constexpr auto shift_type = ShiftType(Common::GetBitRange<6, 5>(opcode));
+
+    if constexpr ((opcode & 0x0F000000) == 0x0F000000) {
+        return &ARM7::ARM_SoftwareInterrupt;
+    } else if constexpr ((opcode & 0x0E000000) == 0x0E000000) {
+        // Coprocessor data operation and register transfer
+        return &ARM7::ARM_UnknownInstruction;
+    } else if constexpr ((opcode & 0x0E000000) == 0x0C000000) {
+        // Coprocessor data transfer
+        return &ARM7::ARM_UnknownInstruction;
+    } else if constexpr ((opcode & 0x0E000000) == 0x0A000000) {
+        return &ARM7::ARM_Branch<bit24>;
+    } else if constexpr ((opcode & 0x0E000000) == 0x08000000) {
+        return &ARM7::ARM_BlockDataTransfer<bit24, bit23, bit22, bit21, bit20>;
+    } else if constexpr ((opcode & 0x0E000010) == 0x06000010) {
+        // Undefined
+        return &ARM7::ARM_UnknownInstruction;
+    } else if constexpr ((opcode & 0x0C000000) == 0x04000000) {
+        // An immediate offset doesn't care about the shift type, so don't make a copy per shift type.
+        constexpr ShiftType offset_shift_type = bit25 ? shift_type : ShiftType::LSL;
+        return &ARM7::ARM_SingleDataTransfer<bit25, bit24, bit23, bit22, bit21, bit20, offset_shift_type>;
+    } else if constexpr ((opcode & 0x0FF000F0) == 0x01200010) {
+        return &ARM7::ARM_BranchAndExchange;
+    } else if constexpr ((opcode & 0x0FB000F0) == 0x01000090) {
+        return &ARM7::ARM_SingleDataSwap<bit22>;
+    } else if constexpr ((opcode & 0x0F8000F0) == 0x00800090) {
+        return &ARM7::ARM_MultiplyLong<bit22, bit21, bit20>;
+    } else if constexpr ((opcode & 0x0FC000F0) == 0x00000090) {
+        return &ARM7::ARM_Multiply<bit21, bit20>;
+    } else if constexpr ((opcode & 0x0E400090) == 0x00400090) {
+        return &ARM7::ARM_HalfwordDataTransferImmediate<bit24, bit23, bit21, bit20, bit6, bit5>;
+    } else if constexpr ((opcode & 0x0E400090) == 0x00000090) {
+        return &ARM7::ARM_HalfwordDataTransferRegister<bit24, bit23, bit21, bit20, bit6, bit5>;
+    } else if constexpr ((opcode & 0x0FB000F0) == 0x01000000) {
+        // PSR transfers are encoded as TST/TEQ/CMP/CMN without the S bit set.
+        return &ARM7::ARM_MRS<bit22>;
+    } else if constexpr ((opcode & 0x0FB000F0) == 0x01200000) {
+        return &ARM7::ARM_MSR<false, bit22>;
+    } else if constexpr ((opcode & 0x0FB00000) == 0x03200000) {
+        return &ARM7::ARM_MSR<true, bit22>;
+    } else if constexpr ((opcode & 0x0C000000) == 0x00000000) {
+        constexpr u8 op = Common::GetBitRange<24, 21>(opcode);
+        // The immediate form doesn't use the shift bits, so don't make a copy per shift type.
+        if constexpr (bit25) {
+            return &ARM7::ARM_DataProcessing<true, op, bit20, false, ShiftType::LSL>;
+        } else {
+            return &ARM7::ARM_DataProcessing<false, op, bit20, bit4, shift_type>;
+        }
+    } else {
+        // The opcode did not meet any of the above conditions.
+        return &ARM7::ARM_UnknownInstruction;
+    }
+}
 
-    // The opcode did not meet any of the above conditions.
-    return Thumb_Instructions::Unknown;
+consteval ARM7::ARMLUT ARM7::GenerateARMLUT() {
+    ARMLUT lut {};
+
+    [&]<std::size_t... I>(std::index_sequence<I...>) {
+        ((lut[I] = GenerateARMLUT_Impl<I>()), ...);
+    }(std::make_index_sequence<ARM_LUT_SIZE>{});
+
+    return lut;
 }
 
-constexpr void ARM7::GenerateThumbLUT() {
+constexpr ARM7::ARMLUT ARM7::arm_lut = GenerateARMLUT();
+
+template <std::size_t I>
+consteval ARM7::ThumbHandler ARM7::GenerateThumbLUT_Impl() {
+    // Put the index bits back where they are in the opcode.
+    constexpr u16 opcode = I << 6;
+
+    constexpr bool bit12 = Common::IsBitSet<12>(opcode);
+    constexpr bool bit11 = Common::IsBitSet<11>(opcode);
+    constexpr bool bit10 = Common::IsBitSet<10>(opcode);
+    constexpr bool bit9 = Common::IsBitSet<9>(opcode);
+    constexpr bool bit8 = Common::IsBitSet<8>(opcode);
+    constexpr bool bit7 = Common::IsBitSet<7>(opcode);
+    constexpr bool bit6 = Common::IsBitSet<6>(opcode);
+
+    if constexpr ((opcode & 0xF000) == 0xF000) {
+        return &ARM7::Thumb_LongBranchWithLink;
+    } else if constexpr ((opcode & 0xF800) == 0xE000) {
+        return &ARM7::Thumb_UnconditionalBranch;
+    } else if constexpr ((opcode & 0xFF00) == 0xDF00) {
+        return &ARM7::Thumb_SoftwareInterrupt;
+    } else if constexpr ((opcode & 0xFF00) == 0xDE00) {
+        // Undefined condition
+        return &ARM7::Thumb_UnknownInstruction;
+    } else if constexpr ((opcode & 0xF000) == 0xD000) {
+        return &ARM7::Thumb_ConditionalBranch<Common::GetBitRange<11, 8>(opcode)>;
+    } else if constexpr ((opcode & 0xF000) == 0xC000) {
+        return &ARM7::Thumb_MultipleLoadStore<bit11>;
+    } else if constexpr ((opcode & 0xF600) == 0xB400) {
+        return &ARM7::Thumb_PushPopRegisters<bit11, bit8>;
+    } else if constexpr ((opcode & 0xFF00) == 0xB000) {
+        return &ARM7::Thumb_AddOffsetToStackPointer<bit7>;
+    } else if constexpr ((opcode & 0xF000) == 0xA000) {
+        return &ARM7::Thumb_LoadAddress<bit11>;
+    } else if constexpr ((opcode & 0xF000) == 0x9000) {
+        return &ARM7::Thumb_SPRelativeLoadStore<bit11>;
+    } else if constexpr ((opcode & 0xF000) == 0x8000) {
+        return &ARM7::Thumb_LoadStoreHalfword<bit11>;
+    } else if constexpr ((opcode & 0xE000) == 0x6000) {
+        return &ARM7::Thumb_LoadStoreWithImmediateOffset<bit12, bit11>;
+    } else if constexpr ((opcode & 0xF200) == 0x5200) {
+        return &ARM7::Thumb_LoadStoreSignExtendedByteHalfword<bit11, bit10>;
+    } else if constexpr ((opcode & 0xF200) == 0x5000) {
+        return &ARM7::Thumb_LoadStoreWithRegisterOffset<bit11, bit10>;
+    } else if constexpr ((opcode & 0xF800) == 0x4800) {
+        return &ARM7::Thumb_PCRelativeLoad;
+    } else if constexpr ((opcode & 0xFC00) == 0x4400) {
+        return &ARM7::Thumb_HiRegisterOperationsBranchExchange<Common::GetBitRange<9, 8>(opcode), bit7, bit6>;
+    } else if constexpr ((opcode & 0xFC00) == 0x4000) {
+        return &ARM7::Thumb_ALUOperations<Common::GetBitRange<9, 6>(opcode)>;
+    } else if constexpr ((opcode & 0xE000) == 0x2000) {
+        return &ARM7::Thumb_MoveCompareAddSubtractImmediate<Common::GetBitRange<12, 11>(opcode)>;
+    } else if constexpr ((opcode & 0xF800) == 0x1800) {
+        return &ARM7::Thumb_AddSubtract<bit10, bit9>;
+    } else if constexpr ((opcode & 0xE000) == 0x0000) {
+        return &ARM7::Thumb_MoveShiftedRegister<ShiftType(Common::GetBitRange<12, 11>(opcode))>;
+    } else {
+        // The opcode did not meet any of the above conditions.
+        return &ARM7::Thumb_UnknownInstruction;
+    }
+}
+
+consteval ARM7::ThumbLUT ARM7::GenerateThumbLUT() {
+    ThumbLUT lut {};
+
     [&]<std::size_t... I>(std::index_sequence<I...>) {
-        ((thumb_lut[I] = GenerateThumbLUT_Impl<I>()), ...);
+        ((lut[I] = GenerateThumbLUT_Impl<I>()), ...);
     }(std::make_index_sequence<THUMB_LUT_SIZE>{});
+
+    return lut;
 }
 
+constexpr ARM7::ThumbLUT ARM7::thumb_lut = GenerateThumbLUT();
+
+consteval ARM7::ConditionLUT ARM7::GenerateConditionLUT() {
+    ConditionLUT lut {};
+
+    for (u8 cond = 0; cond < lut.size(); cond++) {
+        for (u8 flags = 0; flags < 16; flags++) {
+            const bool negative = (flags & FLAG_N) != 0;
+            const bool zero = (flags & FLAG_Z) != 0;
+            const bool carry = (flags & FLAG_C) != 0;
+            const bool overflow = (flags & FLAG_V) != 0;
+
+            bool passed = false;
+            switch (cond) {
+                case 0x0: passed = zero; break;
+                case 0x1: passed = !zero; break;
+                case 0x2: passed = carry; break;
+                case 0x3: passed = !carry; break;
+                case 0x4: passed = negative; break;
+                case 0x5: passed = !negative; break;
+                case 0x6: passed = overflow; break;
+                case 0x7: passed = !overflow; break;
+                case 0x8: passed = (carry && !zero); break;
+                case 0x9: passed = (!carry || zero); break;
+                case 0xA: passed = (negative == overflow); break;
+                case 0xB: passed = (negative != overflow); break;
+                case 0xC: passed = (!zero && (negative == overflow)); break;
+                case 0xD: passed = (zero || (negative != overflow)); break;
+                case 0xE: passed = true; break;
+                // 0xF (NV) never passes on ARMv4.
+                default: break;
+            }
+
+            if (passed) {
+                lut[cond] |= (1 << flags);
+            }
+        }
+    }
+
+    return lut;
+}
+
+constexpr ARM7::ConditionLUT ARM7::condition_lut = GenerateConditionLUT();
+
 ARM7::Thumb_Instructions ARM7::DecodeThumbInstruction(const u16 opcode) const {
-    return thumb_lut[Common::GetBitRange<15, 8>(opcode)];
+    if ((opcode & 0xF000) == 0xF000) return Thumb_Instructions::LongBranchWithLink;
+    if ((opcode & 0xF800) == 0xE000) return Thumb_Instructions::UnconditionalBranch;
+    if ((opcode & 0xFF00) == 0xDF00) return Thumb_Instructions::SoftwareInterrupt;
+    if ((opcode & 0xF000) == 0xD000) return Thumb_Instructions::ConditionalBranch;
+    if ((opcode & 0xF000) == 0xC000) return Thumb_Instructions::MultipleLoadStore;
+    if ((opcode & 0xF600) == 0xB400) return Thumb_Instructions::PushPopRegisters;
+    if ((opcode & 0xFF00) == 0xB000) return Thumb_Instructions::AddOffsetToStackPointer;
+    if ((opcode & 0xF000) == 0xA000) return Thumb_Instructions::LoadAddress;
+    if ((opcode & 0xF000) == 0x9000) return Thumb_Instructions::SPRelativeLoadStore;
+    if ((opcode & 0xF000) == 0x8000) return Thumb_Instructions::LoadStoreHalfword;
+    if ((opcode & 0xE000) == 0x6000) return Thumb_Instructions::LoadStoreWithImmediateOffset;
+    if ((opcode & 0xF200) == 0x5200) return Thumb_Instructions::LoadStoreSignExtendedByteHalfword;
+    if ((opcode & 0xF200) == 0x5000) return Thumb_Instructions::LoadStoreWithRegisterOffset;
+    if ((opcode & 0xF800) == 0x4800) return Thumb_Instructions::PCRelativeLoad;
+    if ((opcode & 0xFC00) == 0x4400) return Thumb_Instructions::HiRegisterOperationsBranchExchange;
+    if ((opcode & 0xFC00) == 0x4000) return Thumb_Instructions::ALUOperations;
+    if ((opcode & 0xE000) == 0x2000) return Thumb_Instructions::MoveCompareAddSubtractImmediate;
+    if ((opcode & 0xF800) == 0x1800) return Thumb_Instructions::AddSubtract;
+    if ((opcode & 0xE000) == 0x0000) return Thumb_Instructions::MoveShiftedRegister;
+
+    // The opcode did not meet any of the above conditions.
+    return Thumb_Instructions::Unknown;
 }
 
-void ARM7::ExecuteThumbInstruction(const Thumb_Instructions instr, const u16 opcode) {
-    switch (instr) {
-        case Thumb_Instructions::MoveShiftedRegister:
-            Thumb_MoveShiftedRegister(opcode);
-            break;
-        case Thumb_Instructions::AddSubtract:
-            Thumb_AddSubtract(opcode);
-            break;
-        case Thumb_Instructions::MoveCompareAddSubtractImmediate:
-            Thumb_MoveCompareAddSubtractImmediate(opcode);
-            break;
-        case Thumb_Instructions::ALUOperations:
-            Thumb_ALUOperations(opcode);
-            break;
-        case Thumb_Instructions::HiRegisterOperationsBranchExchange:
-            Thumb_HiRegisterOperationsBranchExchange(opcode);
-            break;
-        case Thumb_Instructions::PCRelativeLoad:
-            Thumb_PCRelativeLoad(opcode);
-            break;
-        case Thumb_Instructions::LoadStoreWithRegisterOffset:
-            Thumb_LoadStoreWithRegisterOffset(opcode);
-            break;
-        case Thumb_Instructions::LoadStoreSignExtendedByteHalfword:
-            Thumb_LoadStoreSignExtendedByteHalfword(opcode);
-            break;
-        case Thumb_Instructions::LoadStoreWithImmediateOffset:
-            Thumb_LoadStoreWithImmediateOffset(opcode);
-            break;
-        case Thumb_Instructions::LoadStoreHalfword:
-            Thumb_LoadStoreHalfword(opcode);
-            break;
-        case Thumb_Instructions::SPRelativeLoadStore:
-            Thumb_SPRelativeLoadStore(opcode);
-            break;
-        case Thumb_Instructions::LoadAddress:
-            Thumb_LoadAddress(opcode);
-            break;
-        case Thumb_Instructions::AddOffsetToStackPointer:
-            Thumb_AddOffsetToStackPointer(opcode);
-            break;
-        case Thumb_Instructions::PushPopRegisters:
-            Thumb_PushPopRegisters(opcode);
-            break;
-        case Thumb_Instructions::MultipleLoadStore:
-            Thumb_MultipleLoadStore(opcode);
-            break;
-        case Thumb_Instructions::ConditionalBranch:
-            Thumb_ConditionalBranch(opcode);
-            break;
-        case Thumb_Instructions::SoftwareInterrupt:
-            Thumb_SoftwareInterrupt(opcode);
-            break;
-        case Thumb_Instructions::UnconditionalBranch:
-            Thumb_UnconditionalBranch(opcode);
-            break;
-        case Thumb_Instructions::LongBranchWithLink:
-            Thumb_LongBranchWithLink(opcode);
-            break;
+void ARM7::ExecuteThumbInstruction(const u16 opcode) {
+    (this->*thumb_lut[GetThumbLUTIndex(opcode)])(opcode);
+}
 
-        case Thumb_Instructions::Unknown:
-        default:
-            UNIMPLEMENTED_MSG("interpreter: unknown THUMB instruction ({})", Common::GetUnderlyingValue(instr));
-    }
+void ARM7::Thumb_UnknownInstruction(const u16 opcode) {
+    UNIMPLEMENTED_MSG("interpreter: unimplemented THUMB instruction (opcode: {:04X}, pc: {:08X})", opcode, GetPC() - 4);
+}
+
+bool ARM7::MatchesState(const ARM7& other) const {
+    return gpr == other.gpr && GetCPSR() == other.GetCPSR() && pipeline == other.pipeline && halted == other.halted;
 }
 
 void ARM7::DumpRegisters() {
@@ -266,51 +544,32 @@ void ARM7::DumpRegisters() {
     fmt::print("r4: {:08X} r5: {:08X} r6: {:08X} r7: {:08X}\n", GetRegister(4), GetRegister(5), GetRegister(6), GetRegister(7));
     fmt::print("r8: {:08X} r9: {:08X} r10:{:08X} r11:{:08X}\n", GetRegister(8), GetRegister(9), GetRegister(10), GetRegister(11));
     fmt::print("r12:{:08X} sp: {:08X} lr: {:08X} pc: {:08X}\n", GetRegister(12), GetSP(), GetLR(), cpsr.flags.thumb_mode ? GetPC() - 4 : GetPC() - 8);
-    fmt::print("cpsr:{:08X}\n", cpsr.raw);
+    fmt::print("cpsr:{:08X}\n", GetCPSR());
 }
 
 void ARM7::FillPipeline() {
     if (cpsr.flags.thumb_mode) {
-        pipeline[0] = bus.Read16(gpr[15]);
+        pipeline[0] = Fetch<u16>(gpr[15]);
         // LDEBUG("r15={:08X} p0={:04X}", gpr[15], pipeline[0]);
         gpr[15] += 2;
-        pipeline[1] = bus.Read16(gpr[15]);
+        pipeline[1] = Fetch<u16>(gpr[15]);
         // LDEBUG("r15={:08X} p1={:04X}", gpr[15], pipeline[1]);
     } else {
-        pipeline[0] = bus.Read32(gpr[15]);
+        pipeline[0] = Fetch<u32>(gpr[15]);
         // LDEBUG("r15={:08X} p0={:08X}", gpr[15], pipeline[0]);
         gpr[15] += 4;
-        pipeline[1] = bus.Read32(gpr[15]);
+        pipeline[1] = Fetch<u32>(gpr[15]);
         // LDEBUG("r15={:08X} p1={:08X}", gpr[15], pipeline[1]);
     }
 }
 
-u32 ARM7::Shift(const u64 operand_to_shift, const ShiftType shift_type, const u8 shift_amount, const bool set_condition_codes) {
-    if (!shift_amount) { // shift by 0 digits
-        return operand_to_shift;
-    }
-
-    switch (shift_type) {
-        case ShiftType::LSL:
-            return Shift_LSL(operand_to_shift, shift_amount, set_condition_codes);
-        case ShiftType::LSR:
-            return Shift_LSR(operand_to_shift, shift_amount, set_condition_codes);
-        case ShiftType::ASR:
-            return Shift_ASR(operand_to_shift, shift_amount, set_condition_codes);
-        case ShiftType::ROR:
-            return Shift_RotateRight(operand_to_shift, shift_amount, set_condition_codes);
-        default:
-            UNREACHABLE();
-    }
-}
-
 u32 ARM7::Shift_LSL(const u64 operand_to_shift, const u8 shift_amount, const bool set_condition_codes) {
     if (shift_amount >= 32) {
         if (set_condition_codes) {
             if (shift_amount == 32) {
-                cpsr.flags.carry = Common::IsBitSet<0>(operand_to_shift);
+                SetCarry(Common::IsBitSet<0>(operand_to_shift));
             } else {
-                cpsr.flags.carry = false;
+                SetCarry(false);
             }
         }
 
@@ -318,7 +577,7 @@ u32 ARM7::Shift_LSL(const u64 operand_to_shift, const u8 shift_amount, const boo
     }
 
     if (set_condition_codes) {
-        cpsr.flags.carry = Common::IsBitSet<0>(operand_to_shift >> (32 - shift_amount));
+        SetCarry(Common::IsBitSet<0>(operand_to_shift >> (32 - shift_amount)));
     }
 
     return operand_to_shift << shift_amount;
@@ -328,9 +587,9 @@ u32 ARM7::Shift_LSR(const u64 operand_to_shift, const u8 shift_amount, const boo
     if (shift_amount >= 32) {
         if (set_condition_codes) {
             if (shift_amount == 32) {
-                cpsr.flags.carry = Common::IsBitSet<31>(operand_to_shift);
+                SetCarry(Common::IsBitSet<31>(operand_to_shift));
             } else {
-                cpsr.flags.carry = false;
+                SetCarry(false);
             }
         }
 
@@ -338,7 +597,7 @@ u32 ARM7::Shift_LSR(const u64 operand_to_shift, const u8 shift_amount, const boo
     }
 
     if (set_condition_codes) {
-        cpsr.flags.carry = Common::IsBitSet<0>(operand_to_shift >> (shift_amount - 1));
+        SetCarry(Common::IsBitSet<0>(operand_to_shift >> (shift_amount - 1)));
     }
 
     return operand_to_shift >> shift_amount;
@@ -350,12 +609,12 @@ u32 ARM7::Shift_ASR(const u64 operand_to_shift, const u8 shift_amount, const boo
     if (shift_amount >= 32) {
         result = u32(s32(operand_to_shift) >> 31);
         if (set_condition_codes) {
-            cpsr.flags.carry = Common::IsBitSet<0>(result);
+            SetCarry(Common::IsBitSet<0>(result));
         }
     } else {
         result = u32(s32(operand_to_shift) >> shift_amount);
         if (set_condition_codes) {
-            cpsr.flags.carry = Common::IsBitSet<0>(operand_to_shift >> (shift_amount - 1));
+            SetCarry(Common::IsBitSet<0>(operand_to_shift >> (shift_amount - 1)));
         }
     }
 
@@ -370,29 +629,26 @@ u32 ARM7::Shift_RotateRight(const u32 operand_to_rotate, const u8 rotate_amount,
     const u32 result = std::rotr(operand_to_rotate, rotate_amount);
 
     if (set_condition_codes) {
-        cpsr.flags.carry = Common::IsBitSet<31>(result);
+        SetCarry(Common::IsBitSet<31>(result));
     }
 
     return result;
 }
 
 u32 ARM7::Shift_RRX(const u32 operand_to_rotate, const bool set_condition_codes) {
-    const u32 result = (operand_to_rotate >> 1) | (cpsr.flags.carry << 31);
+    const u32 result = (operand_to_rotate >> 1) | (GetCarry() << 31);
 
     if (set_condition_codes) {
-        cpsr.flags.carry = Common::IsBitSet<0>(operand_to_rotate);
+        SetCarry(Common::IsBitSet<0>(operand_to_rotate));
     }
 
     return result;
 }
 
 u32 ARM7::ADC(const u32 operand1, const u32 operand2, const bool change_flags) {
-    u32 result = operand1 + operand2 + cpsr.flags.carry;
+    u32 result = operand1 + operand2 + GetCarry();
     if (change_flags) {
-        cpsr.flags.negative = Common::IsBitSet<31>(result);
-        cpsr.flags.zero = (result == 0);
-        cpsr.flags.carry = (result < operand1);
-        cpsr.flags.overflow = ((operand1 ^ result) & (operand2 ^ result)) >> 31;
+        SetNZCV(Common::IsBitSet<31>(result), result == 0, result < operand1, Common::IsBitSet<31>(((operand1 ^ result) & (operand2 ^ result))));
     }
 
     return result;
@@ -401,10 +657,7 @@ u32 ARM7::ADC(const u32 operand1, const u32 operand2, const bool change_flags) {
 u32 ARM7::ADD(const u32 operand1, const u32 operand2, const bool change_flags) {
     u32 result = operand1 + operand2;
     if (change_flags) {
-        cpsr.flags.negative = Common::IsBitSet<31>(result);
-        cpsr.flags.zero = (result == 0);
-        cpsr.flags.carry = (result < operand1);
-        cpsr.flags.overflow = ((operand1 ^ result) & (operand2 ^ result)) >> 31;
+        SetNZCV(Common::IsBitSet<31>(result), result == 0, result < operand1, Common::IsBitSet<31>(((operand1 ^ result) & (operand2 ^ result))));
     }
 
     return result;
@@ -413,28 +666,19 @@ u32 ARM7::ADD(const u32 operand1, const u32 operand2, const bool change_flags) {
 void ARM7::CMN(const u32 operand1, const u32 operand2) {
     u32 result = operand1 + operand2;
 
-    cpsr.flags.negative = Common::IsBitSet<31>(result);
-    cpsr.flags.zero = (result == 0);
-    cpsr.flags.carry = (result < operand1);
-    cpsr.flags.overflow = ((operand1 ^ result) & (operand2 ^ result)) >> 31;
+    SetNZCV(Common::IsBitSet<31>(result), result == 0, result < operand1, Common::IsBitSet<31>(((operand1 ^ result) & (operand2 ^ result))));
 }
 
 void ARM7::CMP(const u32 operand1, const u32 operand2) {
     u32 result = operand1 - operand2;
 
-    cpsr.flags.negative = Common::IsBitSet<31>(result);
-    cpsr.flags.zero = (result == 0);
-    cpsr.flags.carry = (result <= operand1);
-    cpsr.flags.overflow = ((operand1 ^ result) & (~operand2 ^ result)) >> 31;
+    SetNZCV(Common::IsBitSet<31>(result), result == 0, result <= operand1, Common::IsBitSet<31>(((operand1 ^ result) & (~operand2 ^ result))));
 }
 
 u32 ARM7::SBC(const u32 operand1, const u32 operand2, const bool change_flags) {
-    u32 result = operand1 - operand2 - !cpsr.flags.carry;
+    u32 result = operand1 - operand2 - !GetCarry();
     if (change_flags) {
-        cpsr.flags.negative = Common::IsBitSet<31>(result);
-        cpsr.flags.zero = (result == 0);
-        cpsr.flags.carry = (result <= operand1);
-        cpsr.flags.overflow = ((operand1 ^ result) & (~operand2 ^ result)) >> 31;
+        SetNZCV(Common::IsBitSet<31>(result), result == 0, result <= operand1, Common::IsBitSet<31>(((operand1 ^ result) & (~operand2 ^ result))));
     }
 
     return result;
@@ -443,10 +687,7 @@ u32 ARM7::SBC(const u32 operand1, const u32 operand2, const bool change_flags) {
 u32 ARM7::SUB(const u32 operand1, const u32 operand2, const bool change_flags) {
     u32 result = operand1 - operand2;
     if (change_flags) {
-        cpsr.flags.negative = Common::IsBitSet<31>(result);
-        cpsr.flags.zero = (result == 0);
-        cpsr.flags.carry = (result <= operand1);
-        cpsr.flags.overflow = ((operand1 ^ result) & (~operand2 ^ result)) >> 31;
+        SetNZCV(Common::IsBitSet<31>(result), result == 0, result <= operand1, Common::IsBitSet<31>(((operand1 ^ result) & (~operand2 ^ result))));
     }
 
     return result;
@@ -455,52 +696,14 @@ u32 ARM7::SUB(const u32 operand1, const u32 operand2, const bool change_flags) {
 void ARM7::TEQ(const u32 operand1, const u32 operand2) {
     u32 result = operand1 ^ operand2;
 
-    cpsr.flags.negative = Common::IsBitSet<31>(result);
-    cpsr.flags.zero = (result == 0);
+    SetNZ(Common::IsBitSet<31>(result), result == 0);
     // carry flag?
 }
 
 void ARM7::TST(const u32 operand1, const u32 operand2) {
     u32 result = operand1 & operand2;
 
-    cpsr.flags.negative = Common::IsBitSet<31>(result);
-    cpsr.flags.zero = (result == 0);
+    SetNZ(Common::IsBitSet<31>(result), result == 0);
     // carry flag?
 }
 
-bool ARM7::CheckConditionCode(const u8 cond) {
-    switch (cond) {
-        case 0x0:
-            return cpsr.flags.zero;
-        case 0x1:
-            return !cpsr.flags.zero;
-        case 0x2:
-            return cpsr.flags.carry;
-        case 0x3:
-            return !cpsr.flags.carry;
-        case 0x4:
-            return cpsr.flags.negative;
-        case 0x5:
-            return !cpsr.flags.negative;
-        case 0x6:
-            return cpsr.flags.overflow;
-        case 0x7:
-            return !cpsr.flags.overflow;
-        case 0x8:
-            return (cpsr.flags.carry && !cpsr.flags.zero);
-        case 0x9:
-            return (!cpsr.flags.carry || cpsr.flags.zero);
-        case 0xA:
-            return (cpsr.flags.negative == cpsr.flags.overflow);
-        case 0xB:
-            return (cpsr.flags.negative != cpsr.flags.overflow);
-        case 0xC:
-            return (!cpsr.flags.zero && (cpsr.flags.negative == cpsr.flags.overflow));
-        case 0xD:
-            return (cpsr.flags.zero || (cpsr.flags.negative != cpsr.flags.overflow));
-        case 0xE:
-            return true;
-        [[unlikely]] default: // cond is 0xF
-            UNREACHABLE_MSG("invalid condition code 0x{:X}", cond);
-    }
-}
@@ -1,23 +1,67 @@
 #pragma once
 
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
 #include "bus.h"
 #include "common/logging.h"
 #include "common/types.h"
-#include "timer.h"
+#include "scheduler.h"
+
+class JIT;
 
 class ARM7 {
 public:
-    ARM7(Bus& bus_, Timers& timers_);
+    ARM7(Bus& bus_, Scheduler& scheduler_);
+    ~ARM7();
+
+    // Switches from the block interpreter to the JIT, if the host supports it.
+    void EnableJIT();
 
+    // Executes instructions until the scheduler's timestamp reaches the given timestamp.
+    // Events are not run here, so callers shouldn't pass a timestamp past the next event.
+    void RunUntil(u64 timestamp);
     void Step(bool dump_registers);
 
+    // Lets a known idle loop skip the usual detection, see Cartridge::GetIdleLoopAddress().
+    void SetIdleLoopAddress(u32 address) { known_idle_loop_address = address; }
+
     [[nodiscard]] inline u32 GetPC() const { return GetRegister(15); }
 
-    [[nodiscard]] inline u32 GetCPSR() const { return cpsr.raw; }
+    [[nodiscard]] inline u32 GetCPSR() const { return cpsr.raw | (nzcv << 28); }
+
+    // Called by the bus on writes to WRAM, so that blocks decoded from the written page get rebuilt.
+    inline void InvalidateBlocks(const u32 address) {
+        const std::size_t page = GetWRAMPage(address);
+        if (wram_page_has_blocks[page]) {
+            wram_page_has_blocks[page] = false;
+            wram_page_generations[page]++;
+            exit_block = true;
+        }
+    }
+
+    // Same as above, for every page from first_address to last_address (inclusive, same WRAM mirror).
+    inline void InvalidateBlocks(const u32 first_address, const u32 last_address) {
+        for (u32 address = first_address & ~(BLOCK_PAGE_SIZE - 1); address <= last_address; address += BLOCK_PAGE_SIZE) {
+            InvalidateBlocks(address);
+        }
+    }
+
+    // Called when an event got scheduled during the current instruction, so that the CPU stops
+    // for it if it's due before the end of the timeslice.
+    void StopForNewEvent() { exit_block = true; }
+
+    // Compares the registers with another CPU's, for running the JIT in lockstep with the interpreter.
+    [[nodiscard]] bool MatchesState(const ARM7& other) const;
+    void DumpRegisters();
 
     bool halted = false;
 
 private:
+    friend class JIT;
+
     [[nodiscard]] inline u32 GetSP() const { return GetRegister(13); }
     inline void SetSP(u32 value) { SetRegister(13, value); }
 
@@ -26,108 +70,14 @@ private:
 
     inline void SetPC(u32 value) { SetRegister(15, value); }
 
+    // The active mode's registers always live in `gpr`, so accessing them is just an index.
+    // Banked registers are swapped in and out by SetProcessorMode() and SetCPSR().
     inline u32 GetRegister(u8 reg) const {
-        ASSERT(reg <= 15);
-
-        if (reg <= 7) {
-            return gpr[reg];
-        }
-
-        switch (cpsr.flags.processor_mode) {
-            case ProcessorMode::System:
-            case ProcessorMode::User:
-                return gpr[reg];
-            case ProcessorMode::FIQ:
-                if (reg >= 8 && reg <= 14) {
-                    return fiq_r[reg - 8];
-                }
-
-                return gpr[reg];
-            case ProcessorMode::Supervisor:
-                if (reg == 13 || reg == 14) {
-                    return svc_r[reg - 13];
-                }
-
-                return gpr[reg];
-            case ProcessorMode::Abort:
-                if (reg == 13 || reg == 14) {
-                    return abt_r[reg - 13];
-                }
-
-                return gpr[reg];
-            case ProcessorMode::IRQ:
-                if (reg == 13 || reg == 14) {
-                    return irq_r[reg - 13];
-                }
-
-                return gpr[reg];
-            case ProcessorMode::Undefined:
-                if (reg == 13 || reg == 14) {
-                    return und_r[reg - 13];
-                }
-
-                return gpr[reg];
-            default:
-                UNREACHABLE_MSG("invalid ARM7 processor mode 0x{:X}", Common::GetUnderlyingValue(cpsr.flags.processor_mode));
-        }
+        return gpr[reg];
     }
 
     inline void SetRegister(u8 reg, u32 value) {
-        ASSERT(reg <= 15);
-
-        if (reg <= 7) {
-            gpr[reg] = value;
-            return;
-        }
-
-        switch (cpsr.flags.processor_mode) {
-            case ProcessorMode::System:
-            case ProcessorMode::User:
-                gpr[reg] = value;
-                break;
-            case ProcessorMode::FIQ:
-                if (reg >= 8 && reg <= 14) {
-                    fiq_r[reg - 8] = value;
-                    break;
-                }
-
-                gpr[reg] = value;
-                break;
-            case ProcessorMode::Supervisor:
-                if (reg == 13 || reg == 14) {
-                    svc_r[reg - 13] = value;
-                    break;
-                }
-
-                gpr[reg] = value;
-                break;
-            case ProcessorMode::Abort:
-                if (reg == 13 || reg == 14) {
-                    abt_r[reg - 13] = value;
-                    break;
-                }
-
-                gpr[reg] = value;
-                break;
-            case ProcessorMode::IRQ:
-                if (reg == 13 || reg == 14) {
-                    irq_r[reg - 13] = value;
-                    break;
-                }
-
-                gpr[reg] = value;
-                break;
-            case ProcessorMode::Undefined:
-                if (reg == 13 || reg == 14) {
-                    und_r[reg - 13] = value;
-                    break;
-                }
-
-                gpr[reg] = value;
-                break;
-            default:
-                UNREACHABLE_MSG("invalid ARM7 processor mode 0x{:X}", Common::GetUnderlyingValue(cpsr.flags.processor_mode));
-        }
+        gpr[reg] = value;
 
         if (reg == 15) {
             // Refill the pipeline whenever we change R15 aka the PC
@@ -139,7 +89,7 @@ private:
         switch (cpsr.flags.processor_mode) {
             case ProcessorMode::System:
             case ProcessorMode::User:
-                return cpsr.raw;
+                return GetCPSR();
             case ProcessorMode::Supervisor:
                 return spsr_svc.raw;
             case ProcessorMode::FIQ:
@@ -226,28 +176,135 @@ private:
         System = 0b11111,
     };
 
-    void HandleInterrupts();
+    // Swaps the banked registers of the old and new modes.
+    void SetProcessorMode(ProcessorMode new_mode);
+    void SetCPSR(u32 value);
+    [[nodiscard]] std::array<u32, 2>& GetBankedRegisters(ProcessorMode mode);
+
+    ALWAYS_INLINE void HandleInterrupts() {
+        if (interrupts.IsIRQLineAsserted()) [[unlikely]] {
+            HandleAssertedIRQLine();
+        }
+    }
+
+    void HandleAssertedIRQLine();
     bool started_ime_delay = false;
     u32 ime_delay = 2;
 
+    // A short backward branch is treated as an idle loop when an iteration ends with the
+    // same registers as the last one and nothing was written to the bus in between. Only a
+    // scheduled event can change the outcome of such a loop, so the CPU can skip ahead. Loops
+    // that read a timer counter are never idle, since the counter changes without an event.
+    static constexpr u32 MAX_IDLE_LOOP_LENGTH = 0x40;
+    struct IdleLoopSnapshot {
+        u32 target = 0xFFFFFFFF;
+        u64 bus_write_count = 0;
+        u64 bus_volatile_read_count = 0;
+        u32 cpsr = 0;
+        std::array<u32, 15> gpr {};
+    } idle_loop_snapshot;
+    std::optional<u32> known_idle_loop_address;
+    bool idle_loop_detected = false;
+
+    void DetectIdleLoop(u32 branch_address, u32 target);
+
     [[nodiscard]] ARM_Instructions DecodeARMInstruction(u32 opcode) const;
-    void ExecuteARMInstruction(ARM_Instructions instr, u32 opcode);
+    void ExecuteARMInstruction(u32 opcode);
     void DisassembleARMInstruction(ARM_Instructions instr, u32 opcode);
 
-    static constexpr std::size_t THUMB_LUT_SIZE = 0x100;
-    using ThumbLUT = std::array<Thumb_Instructions, THUMB_LUT_SIZE>;
+    // The ARM LUT is indexed by bits 27-20 and 7-4 of the opcode, which is enough
+    // to tell every instruction we handle apart.
+    static constexpr std::size_t ARM_LUT_SIZE = 0x1000;
+    using ARMHandler = void (ARM7::*)(u32);
+    using ARMLUT = std::array<ARMHandler, ARM_LUT_SIZE>;
 
     template <std::size_t I>
-    static consteval Thumb_Instructions GenerateThumbLUT_Impl();
+    static consteval ARMHandler GenerateARMLUT_Impl();
 
-    constexpr void GenerateThumbLUT();
-    ThumbLUT thumb_lut {};
+    static consteval ARMLUT GenerateARMLUT();
+    static const ARMLUT arm_lut;
+
+    [[nodiscard]] static constexpr std::size_t GetARMLUTIndex(const u32 opcode) {
+        return ((opcode >> 16) & 0xFF0) | ((opcode >> 4) & 0xF);
+    }
+
+    // The Thumb LUT is indexed by bits 15-6 of the opcode.
+    static constexpr std::size_t THUMB_LUT_SIZE = 0x400;
+    using ThumbHandler = void (ARM7::*)(u16);
+    using ThumbLUT = std::array<ThumbHandler, THUMB_LUT_SIZE>;
+
+    template <std::size_t I>
+    static consteval ThumbHandler GenerateThumbLUT_Impl();
+
+    static consteval ThumbLUT GenerateThumbLUT();
+    static const ThumbLUT thumb_lut;
+
+    [[nodiscard]] static constexpr std::size_t GetThumbLUTIndex(const u16 opcode) {
+        return opcode >> 6;
+    }
 
     [[nodiscard]] Thumb_Instructions DecodeThumbInstruction(u16 opcode) const;
-    void ExecuteThumbInstruction(Thumb_Instructions instr, u16 opcode);
+    void ExecuteThumbInstruction(u16 opcode);
     void DisassembleThumbInstruction(Thumb_Instructions instr, u16 opcode);
 
-    void DumpRegisters();
+    // Code from the BIOS, ROM and WRAM is decoded once into blocks that run up to the
+    // next branch, which saves a bus fetch and a LUT lookup for every instruction after that.
+    // Blocks never cross a page, so a WRAM block only has to watch the page it starts in.
+    static constexpr u32 BLOCK_PAGE_SIZE = 0x400;
+    static constexpr std::size_t EWRAM_PAGE_COUNT = 0x40000 / BLOCK_PAGE_SIZE;
+    static constexpr std::size_t WRAM_PAGE_COUNT = EWRAM_PAGE_COUNT + 0x8000 / BLOCK_PAGE_SIZE;
+
+    struct CachedInstruction {
+        union {
+            ARMHandler arm;
+            ThumbHandler thumb;
+        } handler;
+        u32 opcode;
+        // Only used by ARM instructions, and checked up front to skip the common AL case.
+        u8 condition;
+    };
+
+    // Generated code takes the timestamp to stop at, just like ExecuteBlock().
+    using JITFunction = void (*)(ARM7* arm7, u64 timestamp);
+
+    struct CachedBlock {
+        std::vector<CachedInstruction> instructions;
+        u32 address = 0;
+        // Compiled on first use when the JIT is enabled.
+        JITFunction host_code = nullptr;
+        bool thumb_mode = false;
+        bool in_wram = false;
+        std::size_t wram_page = 0;
+        u32 generation = 0;
+    };
+
+    // Keyed by the block's address, with bit 0 set for Thumb blocks.
+    std::unordered_map<u32, CachedBlock> block_cache;
+    std::array<bool, WRAM_PAGE_COUNT> wram_page_has_blocks {};
+    std::array<u32, WRAM_PAGE_COUNT> wram_page_generations {};
+    // Makes the current block stop after the instruction that is running, because its code was
+    // overwritten or something needs the CPU to stop earlier than it was told to.
+    bool exit_block = false;
+
+    [[nodiscard]] static constexpr std::size_t GetWRAMPage(const u32 address) {
+        if (((address >> 24) & 0xF) == 0x2) {
+            return (address & 0x3FFFF) / BLOCK_PAGE_SIZE;
+        }
+
+        return EWRAM_PAGE_COUNT + (address & 0x7FFF) / BLOCK_PAGE_SIZE;
+    }
+
+    [[nodiscard]] static bool IsCacheable(u32 address);
+    [[nodiscard]] static bool EndsARMBlock(u32 opcode);
+    [[nodiscard]] static bool EndsThumbBlock(u16 opcode);
+
+    [[nodiscard]] CachedBlock* GetBlock();
+    void CompileBlock(CachedBlock& block, u32 address, bool thumb_mode);
+    void ExecuteBlock(CachedBlock& block, u64 timestamp);
+
+#ifdef HA_JIT_X64
+    std::unique_ptr<JIT> jit;
+#endif
 
     void FillPipeline();
 
@@ -259,7 +316,25 @@ private:
         RRX,
     };
 
-    [[nodiscard]] u32 Shift(u64 operand_to_shift, ShiftType shift_type, u8 shift_amount, bool set_condition_codes);
+    template <ShiftType shift_type>
+    [[nodiscard]] u32 Shift(const u64 operand_to_shift, const u8 shift_amount, const bool set_condition_codes) {
+        if (!shift_amount) { // shift by 0 digits
+            return operand_to_shift;
+        }
+
+        if constexpr (shift_type == ShiftType::LSL) {
+            return Shift_LSL(operand_to_shift, shift_amount, set_condition_codes);
+        } else if constexpr (shift_type == ShiftType::LSR) {
+            return Shift_LSR(operand_to_shift, shift_amount, set_condition_codes);
+        } else if constexpr (shift_type == ShiftType::ASR) {
+            return Shift_ASR(operand_to_shift, shift_amount, set_condition_codes);
+        } else if constexpr (shift_type == ShiftType::ROR) {
+            return Shift_RotateRight(operand_to_shift, shift_amount, set_condition_codes);
+        } else {
+            static_assert(shift_type != ShiftType::RRX, "RRX does not take a shift amount");
+        }
+    }
+
     [[nodiscard]] u32 Shift_LSL(u64 operand_to_shift, u8 shift_amount, bool set_condition_codes);
     [[nodiscard]] u32 Shift_LSR(u64 operand_to_shift, u8 shift_amount, bool set_condition_codes);
     [[nodiscard]] u32 Shift_ASR(u64 operand_to_shift, u8 shift_amount, bool set_condition_codes);
@@ -275,15 +350,59 @@ private:
     void TEQ(u32 operand1, u32 operand2);
     void TST(u32 operand1, u32 operand2);
 
-    [[nodiscard]] bool CheckConditionCode(u8 cond);
+    // Bit N of an entry is set if the condition passes with the flags N, as laid out in `nzcv`.
+    using ConditionLUT = std::array<u16, 16>;
+    static consteval ConditionLUT GenerateConditionLUT();
+    static const ConditionLUT condition_lut;
+
+    [[nodiscard]] inline bool CheckConditionCode(const u8 cond) const {
+        return (condition_lut[cond] >> nzcv) & 1;
+    }
+
     [[nodiscard]] std::string GetConditionCode(u8 cond);
 
     // Instruction pipeline
     std::array<u32, 2> pipeline {};
 
-    // General purpose registers
+    // The memory opcodes were last fetched from. Sequential fetches stay inside it, so they
+    // only have to ask the bus again after a branch into another region.
+    Bus::HostRegion<> fetch_region {};
+
+    template <UnsignedIntegerMax32 T>
+    [[nodiscard]] ALWAYS_INLINE T Fetch(u32 addr) {
+        addr &= ~static_cast<u32>(sizeof(T) - 1);
+
+        u32 offset = addr - fetch_region.start;
+        if (offset >= fetch_region.size) [[unlikely]] {
+            fetch_region = bus.GetHostRegion(addr);
+            offset = addr - fetch_region.start;
+
+            if (offset >= fetch_region.size) {
+                // Nothing to load from directly, e.g. code running from IO.
+                if constexpr (std::is_same_v<T, u16>) {
+                    return bus.Read16(addr);
+                } else {
+                    return bus.Read32(addr);
+                }
+            }
+        }
+
+        T opcode;
+        std::memcpy(&opcode, fetch_region.pointer + offset, sizeof(T));
+        return opcode;
+    }
+
+    // General purpose registers of the current mode
     std::array<u32, 16> gpr {};
 
+    // The registers below hold the banked registers of every mode but the current one.
+
+    // User/System-mode registers
+    std::array<u32, 2> usr_r {};
+
+    // R8-R12 of every mode but FIQ
+    std::array<u32, 5> non_fiq_r {};
+
     // FIQ-mode registers
     std::array<u32, 7> fiq_r {};
 
@@ -307,15 +426,40 @@ private:
             bool thumb_mode : 1;
             bool fiq_disabled : 1;
             bool irq_disabled : 1;
-            u32 : 20;
-            bool overflow : 1;
-            bool carry : 1;
-            bool zero : 1;
-            bool negative : 1;
+            // The condition flags, which are kept in `nzcv` while this is the CPSR.
+            u32 : 24;
         } flags;
     };
 
     PSR cpsr;
+
+    // The CPSR's condition flags are kept apart from the rest of it, so that they can be set
+    // all at once and index the condition LUT directly. GetCPSR() merges them back in.
+    static constexpr u8 FLAG_N = 0b1000;
+    static constexpr u8 FLAG_Z = 0b0100;
+    static constexpr u8 FLAG_C = 0b0010;
+    static constexpr u8 FLAG_V = 0b0001;
+    static constexpr u32 CPSR_FLAGS_MASK = 0xF0000000;
+    u8 nzcv = 0;
+
+    inline void SetNZ(const bool negative, const bool zero) {
+        nzcv = (nzcv & (FLAG_C | FLAG_V)) | (negative ? FLAG_N : 0) | (zero ? FLAG_Z : 0);
+    }
+
+    inline void SetNZCV(const bool negative, const bool zero, const bool carry, const bool overflow) {
+        nzcv = (negative ? FLAG_N : 0) | (zero ? FLAG_Z : 0) | (carry ? FLAG_C : 0) | (overflow ? FLAG_V : 0);
+    }
+
+    [[nodiscard]] inline bool GetCarry() const { return (nzcv & FLAG_C) != 0; }
+
+    inline void SetCarry(const bool carry) {
+        nzcv = (nzcv & ~FLAG_C) | (carry ? FLAG_C : 0);
+    }
+
+    inline void SetIRQsDisabled(const bool value) {
+        cpsr.flags.irq_disabled = value;
+        interrupts.SetCPUIRQsDisabled(value);
+    }
     PSR spsr_fiq;
     PSR spsr_svc;
     PSR spsr_abt;
@@ -323,49 +467,78 @@ private:
     PSR spsr_und;
 
     Bus& bus;
-    Timers& timers;
+    Interrupts& interrupts;
+    Scheduler& scheduler;
+
+    enum class CycleType {
+        Nonsequential,
+        Sequential,
+        Internal,
+    };
 
+    // TODO: take the cycle type and memory region into account
+    inline void AddCycles(u16 cycles, [[maybe_unused]] CycleType cycle_type) {
+        scheduler.AddCycles(cycles);
+    }
+
+    // The handlers below are specialized on the opcode bits that the decode LUTs index by.
+    // Their definitions live in the .inl files included by arm7.cpp.
+    template <bool op2_is_immediate, u8 op, bool set_condition_codes, bool shift_by_register, ShiftType shift_type>
     void ARM_DataProcessing(u32 opcode);
     void ARM_DisassembleDataProcessing(u32 opcode);
 
+    template <bool source_is_spsr>
     void ARM_MRS(u32 opcode);
     void ARM_DisassembleMRS(u32 opcode);
-    template <bool flag_bits_only>
+    template <bool operand_is_immediate, bool destination_is_spsr>
     void ARM_MSR(u32 opcode);
+    template <bool operand_is_immediate, bool destination_is_spsr, bool flag_bits_only>
+    void ARM_MSR_Impl(u32 opcode);
     template <bool flag_bits_only>
     void ARM_DisassembleMSR(u32 opcode);
 
+    template <bool accumulate, bool set_condition_codes>
     void ARM_Multiply(u32 opcode);
     void ARM_DisassembleMultiply(u32 opcode);
 
+    template <bool sign, bool accumulate, bool set_condition_codes>
     void ARM_MultiplyLong(u32 opcode);
     void ARM_DisassembleMultiplyLong(u32 opcode);
 
+    template <bool swap_byte>
     void ARM_SingleDataSwap(u32 opcode);
     void ARM_DisassembleSingleDataSwap(u32 opcode);
 
     void ARM_BranchAndExchange(u32 opcode);
     void ARM_DisassembleBranchAndExchange(u32 opcode);
 
+    template <bool pre_indexing, bool add_offset_to_base, bool write_back, bool load_from_memory, bool sign, bool halfword>
     void ARM_HalfwordDataTransferRegister(u32 opcode);
     void ARM_DisassembleHalfwordDataTransferRegister(u32 opcode);
-    template <bool load_from_memory, bool transfer_halfword>
-    void ARM_HalfwordDataTransferRegister_Impl(u32 opcode, bool sign);
+    template <bool pre_indexing, bool add_offset_to_base, bool write_back, bool load_from_memory, bool transfer_halfword, bool sign>
+    void ARM_HalfwordDataTransferRegister_Impl(u32 opcode);
 
+    template <bool pre_indexing, bool add_offset_to_base, bool write_back, bool load_from_memory, bool sign, bool halfword>
     void ARM_HalfwordDataTransferImmediate(u32 opcode);
     void ARM_DisassembleHalfwordDataTransferImmediate(u32 opcode);
-    void ARM_LoadHalfwordImmediate(u32 opcode, bool sign);
-    void ARM_StoreHalfwordImmediate(u32 opcode, bool sign);
+    template <bool pre_indexing, bool add_offset_to_base, bool write_back, bool sign>
+    void ARM_LoadHalfwordImmediate(u32 opcode);
+    template <bool pre_indexing, bool add_offset_to_base, bool write_back, bool sign>
+    void ARM_StoreHalfwordImmediate(u32 opcode);
+    template <bool pre_indexing, bool add_offset_to_base, bool write_back>
     void ARM_LoadSignedByte(u32 opcode);
 
+    template <bool offset_is_register, bool add_before_transfer, bool add_offset_to_base, bool transfer_byte, bool write_back, bool load_from_memory, ShiftType shift_type>
     void ARM_SingleDataTransfer(u32 opcode);
     void ARM_DisassembleSingleDataTransfer(u32 opcode);
-    template <bool load_from_memory, bool transfer_byte>
+    template <bool offset_is_register, bool add_before_transfer, bool add_offset_to_base, bool write_back, bool load_from_memory, bool transfer_byte, ShiftType shift_type>
     void ARM_SingleDataTransfer_Impl(u32 opcode);
 
+    template <bool pre_indexing, bool add_offset_to_base, bool load_psr, bool write_back, bool load_from_memory>
     void ARM_BlockDataTransfer(u32 opcode);
     void ARM_DisassembleBlockDataTransfer(u32 opcode);
 
+    template <bool link>
     void ARM_Branch(u32 opcode);
     void ARM_DisassembleBranch(u32 opcode);
     
@@ -378,33 +551,40 @@ private:
     void ARM_SoftwareInterrupt(u32 opcode);
     void ARM_DisassembleSoftwareInterrupt(u32 opcode);
 
+    void ARM_UnknownInstruction(u32 opcode);
+
+    template <ShiftType shift_type>
     void Thumb_MoveShiftedRegister(u16 opcode);
     void Thumb_DisassembleMoveShiftedRegister(u16 opcode);
-    void Thumb_LSL(u16 opcode);
-    void Thumb_LSR(u16 opcode);
-    void Thumb_ASR(u16 opcode);
 
+    template <bool operand_is_immediate, bool subtracting>
     void Thumb_AddSubtract(u16 opcode);
     void Thumb_DisassembleAddSubtract(u16 opcode);
 
+    template <u8 op>
     void Thumb_MoveCompareAddSubtractImmediate(u16 opcode);
     void Thumb_DisassembleMoveCompareAddSubtractImmediate(u16 opcode);
 
+    template <u8 op>
     void Thumb_ALUOperations(u16 opcode);
     void Thumb_DisassembleALUOperations(u16 opcode);
 
+    template <u8 op, bool h1, bool h2>
     void Thumb_HiRegisterOperationsBranchExchange(u16 opcode);
     void Thumb_DisassembleHiRegisterOperationsBranchExchange(u16 opcode);
 
     void Thumb_PCRelativeLoad(u16 opcode);
     void Thumb_DisassemblePCRelativeLoad(u16 opcode);
 
+    template <bool load_from_memory, bool transfer_byte>
     void Thumb_LoadStoreWithRegisterOffset(u16 opcode);
     void Thumb_DisassembleLoadStoreWithRegisterOffset(u16 opcode);
 
+    template <bool h_flag, bool sign_extend>
     void Thumb_LoadStoreSignExtendedByteHalfword(u16 opcode);
     void Thumb_DisassembleLoadStoreSignExtendedByteHalfword(u16 opcode);
 
+    template <bool transfer_byte, bool load_from_memory>
     void Thumb_LoadStoreWithImmediateOffset(u16 opcode);
     void Thumb_DisassembleLoadStoreWithImmediateOffset(u16 opcode);
     void Thumb_StoreByteWithImmediateOffset(u16 opcode);
@@ -412,24 +592,31 @@ private:
     void Thumb_StoreWordWithImmediateOffset(u16 opcode);
     void Thumb_LoadWordWithImmediateOffset(u16 opcode);
 
+    template <bool load_from_memory>
     void Thumb_LoadStoreHalfword(u16 opcode);
     void Thumb_DisassembleLoadStoreHalfword(u16 opcode);
 
+    template <bool load_from_memory>
     void Thumb_SPRelativeLoadStore(u16 opcode);
     void Thumb_DisassembleSPRelativeLoadStore(u16 opcode);
 
+    template <bool load_from_sp>
     void Thumb_LoadAddress(u16 opcode);
     void Thumb_DisassembleLoadAddress(u16 opcode);
 
+    template <bool offset_is_negative>
     void Thumb_AddOffsetToStackPointer(u16 opcode);
     void Thumb_DisassembleAddOffsetToStackPointer(u16 opcode);
 
+    template <bool load_from_memory, bool store_lr_load_pc>
     void Thumb_PushPopRegisters(u16 opcode);
     void Thumb_DisassemblePushPopRegisters(u16 opcode);
 
+    template <bool load_from_memory>
     void Thumb_MultipleLoadStore(u16 opcode);
     void Thumb_DisassembleMultipleLoadStore(u16 opcode);
 
+    template <u8 cond>
     void Thumb_ConditionalBranch(u16 opcode);
     void Thumb_DisassembleConditionalBranch(u16 opcode);
 
@@ -441,4 +628,6 @@ private:
 
     void Thumb_LongBranchWithLink(u16 opcode);
     void Thumb_DisassembleLongBranchWithLink(u16 opcode);
+
+    void Thumb_UnknownInstruction(u16 opcode);
 };
@@ -0,0 +1,87 @@
+#include "common/bits.h"
+#include "common/logging.h"
+#include "arm7.h"
+
+bool ARM7::IsCacheable(const u32 address) {
+    switch (address >> 24) {
+        case 0x00:
+            return address < 0x4000;
+        case 0x02:
+        case 0x03:
+        case 0x08:
+        case 0x09:
+        case 0x0A:
+        case 0x0B:
+        case 0x0C:
+        case 0x0D:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool ARM7::EndsARMBlock(const u32 opcode) {
+    if ((opcode & 0x0F000000) == 0x0F000000) return true; // SWI
+    if ((opcode & 0x0E000000) == 0x0A000000) return true; // B, BL
+    if ((opcode & 0x0FFFFFF0) == 0x012FFF10) return true; // BX
+    if ((opcode & 0x0E108000) == 0x08108000) return true; // LDM with R15 in the list
+    if ((opcode & 0x0DB00000) == 0x01200000) return true; // MSR to CPSR, which can change the state
+
+    // Anything else that writes R15. This also catches some instructions that don't
+    // (CMP and friends ignore Rd), but ending a block early is harmless.
+    if ((opcode & 0x0C000000) == 0x00000000 || (opcode & 0x0C000000) == 0x04000000) {
+        return Common::GetBitRange<15, 12>(opcode) == 15;
+    }
+
+    return arm_lut[GetARMLUTIndex(opcode)] == &ARM7::ARM_UnknownInstruction;
+}
+
+bool ARM7::EndsThumbBlock(const u16 opcode) {
+    if ((opcode & 0xF000) == 0xD000) return true; // Conditional branch, SWI
+    if ((opcode & 0xF800) == 0xE000) return true; // Unconditional branch
+    if ((opcode & 0xF000) == 0xF000) return true; // Long branch with link
+    if ((opcode & 0xFF00) == 0xBD00) return true; // POP with PC
+
+    if ((opcode & 0xFC00) == 0x4400) {
+        // BX, or a hi register operation with R15 as the destination
+        return Common::GetBitRange<9, 8>(opcode) == 0x3 || (Common::IsBitSet<7>(opcode) && Common::GetBitRange<2, 0>(opcode) == 7);
+    }
+
+    return thumb_lut[GetThumbLUTIndex(opcode)] == &ARM7::Thumb_UnknownInstruction;
+}
+
+void ARM7::CompileBlock(CachedBlock& block, const u32 address, const bool thumb_mode) {
+    block.instructions.clear();
+    block.address = address;
+    block.host_code = nullptr;
+    block.thumb_mode = thumb_mode;
+
+    const std::unsigned_integral auto region = address >> 24;
+    block.in_wram = (region == 0x2 || region == 0x3);
+    if (block.in_wram) {
+        block.wram_page = GetWRAMPage(address);
+        block.generation = wram_page_generations[block.wram_page];
+        wram_page_has_blocks[block.wram_page] = true;
+    }
+
+    const u32 page_end = (address & ~(BLOCK_PAGE_SIZE - 1)) + BLOCK_PAGE_SIZE;
+    if (thumb_mode) {
+        for (u32 pc = address; pc < page_end; pc += 2) {
+            const u16 opcode = Fetch<u16>(pc);
+            block.instructions.push_back({ .handler = { .thumb = thumb_lut[GetThumbLUTIndex(opcode)] }, .opcode = opcode, .condition = 0xE });
+
+            if (EndsThumbBlock(opcode)) {
+                break;
+            }
+        }
+    } else {
+        for (u32 pc = address; pc < page_end; pc += 4) {
+            const u32 opcode = Fetch<u32>(pc);
+            block.instructions.push_back({ .handler = { .arm = arm_lut[GetARMLUTIndex(opcode)] }, .opcode = opcode, .condition = static_cast<u8>(Common::GetBitRange<31, 28>(opcode)) });
+
+            if (EndsARMBlock(opcode)) {
+                break;
+            }
+        }
+    }
+}
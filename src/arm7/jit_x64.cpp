@@ -0,0 +1,408 @@
+#include <array>
+#include <bit>
+#include <cstring>
+#include <type_traits>
+#include <sys/mman.h>
+#include "arm7/jit_x64.h"
+#include "common/bits.h"
+#include "common/logging.h"
+
+// The generated code keeps these in callee-saved registers:
+//   RBX: the ARM7
+//   R12: the timestamp the block has to stop at
+//   R13: a pointer to the scheduler's timestamp
+
+namespace {
+
+// Handlers are called directly instead of through a member function pointer, which means
+// unpacking the pointer as laid out by the Itanium C++ ABI.
+struct HandlerAddress {
+    const void* function;
+    std::ptrdiff_t this_adjustment;
+};
+
+template <typename Handler>
+HandlerAddress GetHandlerAddress(const Handler handler) {
+    static_assert(sizeof(Handler) == 2 * sizeof(std::uintptr_t));
+    static_assert(!std::is_polymorphic_v<ARM7>, "virtual handlers can't be called directly");
+
+    struct {
+        std::uintptr_t function;
+        std::ptrdiff_t this_adjustment;
+    } raw;
+    std::memcpy(&raw, &handler, sizeof(raw));
+
+    return { reinterpret_cast<const void*>(raw.function), raw.this_adjustment };
+}
+
+}
+
+JIT::JIT(ARM7& arm7_) : arm7(arm7_) {
+    static_assert(sizeof(bool) == 1);
+
+    void* const memory = mmap(nullptr, CODE_BUFFER_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory != MAP_FAILED) {
+        code_buffer = static_cast<u8*>(memory);
+    }
+
+    const auto offset_of = [this](const void* member) {
+        return static_cast<s32>(static_cast<const u8*>(member) - reinterpret_cast<const u8*>(&arm7));
+    };
+    gpr_offset = offset_of(&arm7.gpr[0]);
+    cpsr_offset = offset_of(&arm7.cpsr.raw);
+    nzcv_offset = offset_of(&arm7.nzcv);
+    halted_offset = offset_of(&arm7.halted);
+    idle_loop_detected_offset = offset_of(&arm7.idle_loop_detected);
+    exit_block_offset = offset_of(&arm7.exit_block);
+}
+
+JIT::~JIT() {
+    if (code_buffer) {
+        munmap(code_buffer, CODE_BUFFER_SIZE);
+    }
+}
+
+void JIT::ExecuteBlock(ARM7::CachedBlock& block, const u64 timestamp) {
+    if (!block.host_code) {
+        block.host_code = Compile(block);
+    }
+
+    arm7.exit_block = false;
+    block.host_code(&arm7, timestamp);
+}
+
+void JIT::Flush() {
+    LDEBUG("JIT code buffer is full, flushing");
+
+    for (auto& [key, block] : arm7.block_cache) {
+        block.host_code = nullptr;
+    }
+
+    code_size = 0;
+}
+
+ARM7::JITFunction JIT::Compile(const ARM7::CachedBlock& block) {
+    if (code_size + MAX_BLOCK_OVERHEAD_SIZE + block.instructions.size() * MAX_INSTRUCTION_CODE_SIZE > CODE_BUFFER_SIZE) {
+        Flush();
+    }
+
+    const std::size_t block_start = code_size;
+
+    // push rbx; push r12; push r13
+    Emit8(0x53);
+    Emit8(0x41); Emit8(0x54);
+    Emit8(0x41); Emit8(0x55);
+    // mov rbx, rdi; mov r12, rsi
+    Emit8(0x48); Emit8(0x89); Emit8(0xFB);
+    Emit8(0x49); Emit8(0x89); Emit8(0xF4);
+    // mov r13, &timestamp
+    Emit8(0x49); Emit8(0xBD); Emit64(reinterpret_cast<u64>(&arm7.scheduler.timestamp));
+
+    const u32 instruction_size = block.thumb_mode ? 2 : 4;
+    const u32 cpsr_thumb_bit = 1 << 5;
+
+    std::vector<std::size_t> exit_jumps;
+    std::vector<std::size_t> resync_jumps;
+    std::vector<std::size_t> next_jumps;
+
+    // R15 as it is between instructions, see ARM7::ExecuteBlock().
+    u32 next_pc = block.address + instruction_size;
+
+    for (const ARM7::CachedInstruction& instruction : block.instructions) {
+        for (const std::size_t jump : next_jumps) {
+            PatchJump(jump, code_size);
+        }
+        next_jumps.clear();
+
+        const std::size_t instruction_start = code_size;
+
+        // Only call out to handle interrupts while the IRQ line is asserted.
+        // mov rax, &irq_line; cmp byte [rax], 0
+        Emit8(0x48); Emit8(0xB8); Emit64(reinterpret_cast<u64>(&arm7.interrupts.irq_line));
+        Emit8(0x80); Emit8(0x38); Emit8(0);
+        const std::size_t irq_line_clear_jump = EmitJump(Zero);
+        Emit8(0x48); Emit8(0x89); Emit8(0xDF); // mov rdi, rbx
+        EmitCall(reinterpret_cast<const void*>(&JIT::HandleInterrupts));
+        // cmp dword [rbx + r15], next_pc
+        Emit8(0x81); EmitARM7Operand(7, GetRegisterOffset(15)); Emit32(next_pc);
+        exit_jumps.push_back(EmitJump(NotZero));
+        PatchJump(irq_line_clear_jump, code_size);
+
+        const u32 pc = next_pc + instruction_size;
+        // mov dword [rbx + r15], pc
+        Emit8(0xC7); EmitARM7Operand(0, GetRegisterOffset(15)); Emit32(pc);
+
+        bool compiled_inline = false;
+        if (block.thumb_mode) {
+            compiled_inline = CompileThumbInstruction(static_cast<u16>(instruction.opcode), pc);
+            if (!compiled_inline) {
+                const HandlerAddress handler = GetHandlerAddress(instruction.handler.thumb);
+                CompileHandlerCall(handler.function, handler.this_adjustment, instruction.opcode);
+            }
+        } else {
+            if (instruction.condition != 0xE) {
+                CompileARMCondition(instruction.condition, next_jumps);
+            }
+
+            compiled_inline = CompileARMInstruction(instruction.opcode);
+            if (!compiled_inline) {
+                const HandlerAddress handler = GetHandlerAddress(instruction.handler.arm);
+                CompileHandlerCall(handler.function, handler.this_adjustment, instruction.opcode);
+            }
+        }
+
+        if (!compiled_inline) {
+            // The handler may have written to R15, which refilled the pipeline.
+            // cmp dword [rbx + r15], pc
+            Emit8(0x81); EmitARM7Operand(7, GetRegisterOffset(15)); Emit32(pc);
+            exit_jumps.push_back(EmitJump(NotZero));
+
+            // cmp byte [rbx + flag], 0
+            for (const s32 flag_offset : { halted_offset, idle_loop_detected_offset, exit_block_offset }) {
+                Emit8(0x80); EmitARM7Operand(7, flag_offset); Emit8(0);
+                resync_jumps.push_back(EmitJump(NotZero));
+            }
+
+            // test dword [rbx + cpsr], thumb
+            Emit8(0xF7); EmitARM7Operand(0, cpsr_offset); Emit32(cpsr_thumb_bit);
+            resync_jumps.push_back(EmitJump(block.thumb_mode ? Zero : NotZero));
+        }
+
+        // mov rax, [r13]; cmp rax, r12
+        Emit8(0x49); Emit8(0x8B); Emit8(0x45); Emit8(0x00);
+        Emit8(0x4C); Emit8(0x39); Emit8(0xE0);
+        resync_jumps.push_back(EmitJump(AboveOrEqual));
+
+        ASSERT(code_size - instruction_start <= MAX_INSTRUCTION_CODE_SIZE);
+        next_pc += instruction_size;
+    }
+
+    // Leave the pipeline the way Step() expects to find it.
+    for (const std::size_t jump : next_jumps) {
+        PatchJump(jump, code_size);
+    }
+    for (const std::size_t jump : resync_jumps) {
+        PatchJump(jump, code_size);
+    }
+    Emit8(0x48); Emit8(0x89); Emit8(0xDF); // mov rdi, rbx
+    EmitCall(reinterpret_cast<const void*>(&JIT::ResyncPipeline));
+
+    for (const std::size_t jump : exit_jumps) {
+        PatchJump(jump, code_size);
+    }
+    // pop r13; pop r12; pop rbx; ret
+    Emit8(0x41); Emit8(0x5D);
+    Emit8(0x41); Emit8(0x5C);
+    Emit8(0x5B);
+    Emit8(0xC3);
+
+    return reinterpret_cast<ARM7::JITFunction>(code_buffer + block_start);
+}
+
+bool JIT::CompileARMInstruction(const u32 opcode) {
+    // Only data processing without flag updates is emitted inline. Anything that reads the
+    // carry flag or uses a shift with special cases is left to the interpreter.
+    if (Common::GetBitRange<27, 26>(opcode) != 0 || Common::IsBitSet<20>(opcode)) {
+        return false;
+    }
+
+    const bool op2_is_immediate = Common::IsBitSet<25>(opcode);
+    const std::unsigned_integral auto op = Common::GetBitRange<24, 21>(opcode);
+    const std::unsigned_integral auto rn = Common::GetBitRange<19, 16>(opcode);
+    const std::unsigned_integral auto rd = Common::GetBitRange<15, 12>(opcode);
+    if (rd == 15 || (op >= 0x5 && op <= 0xB)) {
+        return false;
+    }
+
+    if (op2_is_immediate) {
+        const std::unsigned_integral auto rotate_amount = Common::GetBitRange<11, 8>(opcode);
+        const std::unsigned_integral auto imm = Common::GetBitRange<7, 0>(opcode);
+        // mov eax, imm
+        Emit8(0xB8); Emit32(std::rotr(static_cast<u32>(imm), rotate_amount * 2));
+    } else {
+        // Shifts by a register share their encoding space with multiplies and transfers.
+        if (Common::IsBitSet<4>(opcode)) {
+            return false;
+        }
+
+        const std::unsigned_integral auto shift_amount = Common::GetBitRange<11, 7>(opcode);
+        const std::unsigned_integral auto shift_type = Common::GetBitRange<6, 5>(opcode);
+        if (shift_type != 0 && shift_amount == 0) {
+            return false;
+        }
+
+        const std::unsigned_integral auto rm = Common::GetBitRange<3, 0>(opcode);
+        // mov eax, [rbx + rm]
+        Emit8(0x8B); EmitARM7Operand(RAX, GetRegisterOffset(rm));
+        if (shift_amount != 0) {
+            // shl/shr/sar/ror eax, shift_amount
+            static constexpr std::array<u8, 4> SHIFT_OPCODES = { 0xE0, 0xE8, 0xF8, 0xC8 };
+            Emit8(0xC1); Emit8(SHIFT_OPCODES[shift_type]); Emit8(static_cast<u8>(shift_amount));
+        }
+    }
+
+    u8 result = RCX;
+    if (op == 0xD) {
+        result = RAX;
+    } else if (op == 0xF) {
+        Emit8(0xF7); Emit8(0xD0); // not eax
+        result = RAX;
+    } else {
+        if (op == 0xE) {
+            Emit8(0xF7); Emit8(0xD0); // not eax
+        }
+
+        // mov ecx, [rbx + rn]
+        Emit8(0x8B); EmitARM7Operand(RCX, GetRegisterOffset(rn));
+
+        switch (op) {
+            case 0x0:
+            case 0xE:
+                Emit8(0x21); Emit8(0xC1); // and ecx, eax
+                break;
+            case 0x1:
+                Emit8(0x31); Emit8(0xC1); // xor ecx, eax
+                break;
+            case 0x2:
+                Emit8(0x29); Emit8(0xC1); // sub ecx, eax
+                break;
+            case 0x3:
+                Emit8(0x29); Emit8(0xC8); // sub eax, ecx
+                result = RAX;
+                break;
+            case 0x4:
+                Emit8(0x01); Emit8(0xC1); // add ecx, eax
+                break;
+            case 0xC:
+                Emit8(0x09); Emit8(0xC1); // or ecx, eax
+                break;
+            default:
+                UNREACHABLE();
+        }
+    }
+
+    // mov [rbx + rd], result
+    Emit8(0x89); EmitARM7Operand(result, GetRegisterOffset(rd));
+
+    // add qword [r13], 1
+    Emit8(0x49); Emit8(0x83); Emit8(0x45); Emit8(0x00); Emit8(1);
+    return true;
+}
+
+bool JIT::CompileThumbInstruction(const u16 opcode, const u32 pc) {
+    if (Common::GetBitRange<15, 11>(opcode) == 0b00100) {
+        // MOV Rd, #imm
+        const std::unsigned_integral auto rd = Common::GetBitRange<10, 8>(opcode);
+        const std::unsigned_integral auto imm = Common::GetBitRange<7, 0>(opcode);
+
+        // mov dword [rbx + rd], imm
+        Emit8(0xC7); EmitARM7Operand(0, GetRegisterOffset(rd)); Emit32(imm);
+        // The result is known up front, so are N and Z.
+        // and byte [rbx + nzcv], C | V
+        Emit8(0x80); EmitARM7Operand(4, nzcv_offset); Emit8(ARM7::FLAG_C | ARM7::FLAG_V);
+        if (imm == 0) {
+            // or byte [rbx + nzcv], Z
+            Emit8(0x80); EmitARM7Operand(1, nzcv_offset); Emit8(ARM7::FLAG_Z);
+        }
+
+        // add qword [r13], 1
+        Emit8(0x49); Emit8(0x83); Emit8(0x45); Emit8(0x00); Emit8(1);
+        return true;
+    }
+
+    if (Common::GetBitRange<15, 12>(opcode) == 0b1010) {
+        // ADD Rd, PC/SP, #imm
+        const std::unsigned_integral auto rd = Common::GetBitRange<10, 8>(opcode);
+        const u32 offset = Common::GetBitRange<7, 0>(opcode) << 2;
+
+        if (Common::IsBitSet<11>(opcode)) {
+            // mov eax, [rbx + sp]; add eax, offset; mov [rbx + rd], eax
+            Emit8(0x8B); EmitARM7Operand(RAX, GetRegisterOffset(13));
+            Emit8(0x05); Emit32(offset);
+            Emit8(0x89); EmitARM7Operand(RAX, GetRegisterOffset(rd));
+        } else {
+            // mov dword [rbx + rd], address
+            Emit8(0xC7); EmitARM7Operand(0, GetRegisterOffset(rd)); Emit32((pc & ~0b11) + offset);
+        }
+
+        return true;
+    }
+
+    if (Common::GetBitRange<15, 8>(opcode) == 0b10110000) {
+        // ADD SP, #imm
+        const u32 offset = Common::GetBitRange<6, 0>(opcode) << 2;
+
+        // add dword [rbx + sp], offset
+        Emit8(0x81); EmitARM7Operand(0, GetRegisterOffset(13));
+        Emit32(Common::IsBitSet<7>(opcode) ? -offset : offset);
+        return true;
+    }
+
+    return false;
+}
+
+void JIT::CompileARMCondition(const u8 cond, std::vector<std::size_t>& skip_jumps) {
+    // Look the flags up in the condition's row of the condition LUT.
+    // movzx ecx, byte [rbx + nzcv]; mov eax, row; bt eax, ecx
+    Emit8(0x0F); Emit8(0xB6); EmitARM7Operand(RCX, nzcv_offset);
+    Emit8(0xB8); Emit32(ARM7::condition_lut[cond]);
+    Emit8(0x0F); Emit8(0xA3); Emit8(0xC8);
+    skip_jumps.push_back(EmitJump(NotCarry));
+}
+
+void JIT::CompileHandlerCall(const void* handler, const std::ptrdiff_t this_adjustment, const u32 opcode) {
+    Emit8(0x48); Emit8(0x89); Emit8(0xDF); // mov rdi, rbx
+    if (this_adjustment != 0) {
+        // add rdi, this_adjustment
+        Emit8(0x48); Emit8(0x81); Emit8(0xC7); Emit32(static_cast<u32>(this_adjustment));
+    }
+    Emit8(0xBE); Emit32(opcode); // mov esi, opcode
+    EmitCall(handler);
+}
+
+void JIT::HandleInterrupts(ARM7* arm7) {
+    arm7->HandleInterrupts();
+}
+
+void JIT::ResyncPipeline(ARM7* arm7) {
+    arm7->SetPC(arm7->GetPC() - (arm7->cpsr.flags.thumb_mode ? 2 : 4));
+}
+
+void JIT::Emit8(const u8 value) {
+    code_buffer[code_size++] = value;
+}
+
+void JIT::Emit32(const u32 value) {
+    std::memcpy(code_buffer + code_size, &value, sizeof(value));
+    code_size += sizeof(value);
+}
+
+void JIT::Emit64(const u64 value) {
+    std::memcpy(code_buffer + code_size, &value, sizeof(value));
+    code_size += sizeof(value);
+}
+
+void JIT::EmitARM7Operand(const u8 reg_field, const s32 offset) {
+    // mod = 10 (disp32), rm = 011 (rbx)
+    Emit8(0x80 | (reg_field << 3) | 0x3);
+    Emit32(static_cast<u32>(offset));
+}
+
+void JIT::EmitCall(const void* function) {
+    // mov rax, function; call rax
+    Emit8(0x48); Emit8(0xB8); Emit64(reinterpret_cast<u64>(function));
+    Emit8(0xFF); Emit8(0xD0);
+}
+
+std::size_t JIT::EmitJump(const JumpCondition condition) {
+    // jcc rel32
+    Emit8(0x0F); Emit8(0x80 | condition);
+    const std::size_t jump = code_size;
+    Emit32(0);
+    return jump;
+}
+
+void JIT::PatchJump(const std::size_t jump, const std::size_t target) {
+    const s32 displacement = static_cast<s32>(target - (jump + 4));
+    std::memcpy(code_buffer + jump, &displacement, sizeof(displacement));
+}
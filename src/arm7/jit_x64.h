@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "arm7/arm7.h"
+#include "common/types.h"
+
+// Translates the ARM7's cached blocks into x86-64 code.
+//
+// The generated code follows ARM7::ExecuteBlock() one instruction at a time, so interrupts,
+// cycle counting and the timeslice deadline behave exactly like the interpreter. A handful of
+// common instructions are emitted inline; everything else calls the interpreter's handler.
+class JIT {
+public:
+    explicit JIT(ARM7& arm7_);
+    ~JIT();
+
+    JIT(const JIT&) = delete;
+    JIT& operator=(const JIT&) = delete;
+
+    // False if no executable memory could be allocated for the code buffer.
+    [[nodiscard]] bool IsAvailable() const { return code_buffer != nullptr; }
+
+    void ExecuteBlock(ARM7::CachedBlock& block, u64 timestamp);
+
+private:
+    ARM7& arm7;
+
+    static constexpr std::size_t CODE_BUFFER_SIZE = 16 * 1024 * 1024;
+    // Upper bounds used to make sure a whole block fits before we start emitting it.
+    static constexpr std::size_t MAX_BLOCK_OVERHEAD_SIZE = 64;
+    static constexpr std::size_t MAX_INSTRUCTION_CODE_SIZE = 192;
+
+    u8* code_buffer = nullptr;
+    std::size_t code_size = 0;
+
+    // Offsets of the ARM7 fields the generated code accesses through RBX.
+    s32 gpr_offset = 0;
+    s32 cpsr_offset = 0;
+    s32 nzcv_offset = 0;
+    s32 halted_offset = 0;
+    s32 idle_loop_detected_offset = 0;
+    s32 exit_block_offset = 0;
+
+    [[nodiscard]] ARM7::JITFunction Compile(const ARM7::CachedBlock& block);
+    // Throws away all generated code once the buffer is full.
+    void Flush();
+
+    [[nodiscard]] bool CompileARMInstruction(u32 opcode);
+    [[nodiscard]] bool CompileThumbInstruction(u16 opcode, u32 pc);
+    void CompileARMCondition(u8 cond, std::vector<std::size_t>& skip_jumps);
+    void CompileHandlerCall(const void* handler, std::ptrdiff_t this_adjustment, u32 opcode);
+
+    // Helpers called from generated code.
+    static void HandleInterrupts(ARM7* arm7);
+    static void ResyncPipeline(ARM7* arm7);
+
+    // x86-64 emitter
+    enum Register : u8 {
+        RAX = 0,
+        RCX = 1,
+    };
+
+    enum JumpCondition : u8 {
+        NotCarry = 0x3,
+        AboveOrEqual = 0x3,
+        Zero = 0x4,
+        NotZero = 0x5,
+    };
+
+    void Emit8(u8 value);
+    void Emit32(u32 value);
+    void Emit64(u64 value);
+    // Emits the ModRM byte and displacement of a [rbx + offset] operand.
+    void EmitARM7Operand(u8 reg_field, s32 offset);
+    void EmitCall(const void* function);
+    [[nodiscard]] std::size_t EmitJump(JumpCondition condition);
+    void PatchJump(std::size_t jump, std::size_t target);
+
+    [[nodiscard]] s32 GetRegisterOffset(u8 reg) const { return gpr_offset + reg * 4; }
+};
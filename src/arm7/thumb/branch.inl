@@ -0,0 +1,74 @@
+#pragma once
+
+#include "common/bits.h"
+#include "arm7/arm7.h"
+
+template <u8 cond>
+void ARM7::Thumb_ConditionalBranch(const u16 opcode) {
+    const s8 offset = Common::GetBitRange<7, 0>(opcode);
+
+    static_assert(cond < 0xE, "0xE and 0xF don't encode conditional branches");
+
+    if (CheckConditionCode(cond)) {
+        const u32 branch_address = GetPC() - 4;
+        const u32 target = GetPC() + (offset << 1);
+        SetPC(target);
+        DetectIdleLoop(branch_address, target);
+
+        AddCycles(2, CycleType::Sequential);
+        AddCycles(1, CycleType::Nonsequential);
+    }
+}
+
+void ARM7::Thumb_SoftwareInterrupt([[maybe_unused]] const u16 opcode) {
+    LDEBUG("Thumb-mode SWI at {:08X}", GetPC() - 4);
+
+    const u32 lr = GetPC() - 2;
+    const u32 old_cpsr = GetCPSR();
+
+    SetProcessorMode(ProcessorMode::Supervisor);
+    SetLR(lr);
+    cpsr.flags.thumb_mode = false;
+    SetIRQsDisabled(true);
+    SetPC(0x00000008);
+    SetSPSR(old_cpsr);
+
+    AddCycles(2, CycleType::Sequential);
+    AddCycles(1, CycleType::Nonsequential);
+}
+
+void ARM7::Thumb_UnconditionalBranch(const u16 opcode) {
+    s16 offset = Common::GetBitRange<10, 0>(opcode) << 1;
+
+    // Sign-extend to 16 bits
+    offset <<= 4;
+    offset >>= 4;
+
+    const u32 branch_address = GetPC() - 4;
+    const u32 target = GetPC() + offset;
+    SetPC(target);
+    DetectIdleLoop(branch_address, target);
+
+    AddCycles(2, CycleType::Sequential);
+    AddCycles(1, CycleType::Nonsequential);
+}
+
+void ARM7::Thumb_LongBranchWithLink(const u16 opcode) {
+    const u16 next_opcode = bus.Read16(GetPC() - 2);
+    s16 offset = Common::GetBitRange<10, 0>(opcode);
+    const std::unsigned_integral auto next_offset = Common::GetBitRange<10, 0>(next_opcode);
+
+    u32 pc = GetPC();
+
+    offset <<= 5;
+    u32 lr = pc + (static_cast<s32>(offset) << 7);
+
+    pc = lr + (next_offset << 1);
+    lr = GetPC() | 0b1;
+
+    SetLR(lr);
+    SetPC(pc);
+
+    AddCycles(2, CycleType::Sequential);
+    AddCycles(1, CycleType::Nonsequential);
+}
@@ -1,3 +1,5 @@
+#pragma once
+
 #include <range/v3/range/conversion.hpp>
 #include <range/v3/view/filter.hpp>
 #include <range/v3/view/iota.hpp>
@@ -5,103 +7,59 @@
 #include "common/bits.h"
 #include "arm7/arm7.h"
 
+template <ARM7::ShiftType shift_type>
 void ARM7::Thumb_MoveShiftedRegister(const u16 opcode) {
-    const std::unsigned_integral auto op = Common::GetBitRange<12, 11>(opcode);
-    switch (op) {
-        case 0:
-            Thumb_LSL(opcode);
-            break;
-        case 1:
-            Thumb_LSR(opcode);
-            break;
-        case 2:
-            Thumb_ASR(opcode);
-            break;
-        default:
-            UNREACHABLE();
-    }
-
-    timers.AdvanceCycles(1, Timers::CycleType::Sequential);
-}
-
-void ARM7::Thumb_LSL(const u16 opcode) {
-    const std::unsigned_integral auto offset = Common::GetBitRange<10, 6>(opcode);
-    const std::unsigned_integral auto rs = Common::GetBitRange<5, 3>(opcode);
-    const std::unsigned_integral auto rd = Common::GetBitRange<2, 0>(opcode);
-    const u32 source = GetRegister(rs);
-
-    SetRegister(rd, Shift(source, ShiftType::LSL, offset, true));
-
-    cpsr.flags.negative = Common::IsBitSet<31>(GetRegister(rd));
-    cpsr.flags.zero = (GetRegister(rd) == 0);
-}
-
-void ARM7::Thumb_LSR(const u16 opcode) {
     std::unsigned_integral auto offset = Common::GetBitRange<10, 6>(opcode);
     const std::unsigned_integral auto rs = Common::GetBitRange<5, 3>(opcode);
     const std::unsigned_integral auto rd = Common::GetBitRange<2, 0>(opcode);
     const u32 source = GetRegister(rs);
 
-    if (!offset) {
-        offset = 32;
+    // LSR #0 and ASR #0 are used to encode shifts by 32.
+    if constexpr (shift_type != ShiftType::LSL) {
+        if (!offset) {
+            offset = 32;
+        }
     }
 
-    SetRegister(rd, Shift(source, ShiftType::LSR, offset, true));
+    SetRegister(rd, Shift<shift_type>(source, offset, true));
 
-    cpsr.flags.negative = Common::IsBitSet<31>(GetRegister(rd));
-    cpsr.flags.zero = (GetRegister(rd) == 0);
-}
+    SetNZ(Common::IsBitSet<31>(GetRegister(rd)), GetRegister(rd) == 0);
 
-void ARM7::Thumb_ASR(const u16 opcode) {
-    std::unsigned_integral auto offset = Common::GetBitRange<10, 6>(opcode);
-    const std::unsigned_integral auto rs = Common::GetBitRange<5, 3>(opcode);
-    const std::unsigned_integral auto rd = Common::GetBitRange<2, 0>(opcode);
-    const u32 source = GetRegister(rs);
-
-    if (!offset) {
-        offset = 32;
-    }
-
-    SetRegister(rd, Shift(source, ShiftType::ASR, offset, true));
-
-    cpsr.flags.negative = Common::IsBitSet<31>(GetRegister(rd));
-    cpsr.flags.zero = (GetRegister(rd) == 0);
+    AddCycles(1, CycleType::Sequential);
 }
 
+template <bool operand_is_immediate, bool subtracting>
 void ARM7::Thumb_AddSubtract(const u16 opcode) {
-    const bool operand_is_immediate = Common::IsBitSet<10>(opcode);
-    const bool subtracting = Common::IsBitSet<9>(opcode);
     const std::unsigned_integral auto rn_or_immediate = Common::GetBitRange<8, 6>(opcode);
     const std::unsigned_integral auto rs = Common::GetBitRange<5, 3>(opcode);
     const std::unsigned_integral auto rd = Common::GetBitRange<2, 0>(opcode);
 
-    if (subtracting) {
-        if (operand_is_immediate) {
+    if constexpr (subtracting) {
+        if constexpr (operand_is_immediate) {
             SetRegister(rd, SUB(GetRegister(rs), rn_or_immediate, true));
         } else {
             SetRegister(rd, SUB(GetRegister(rs), GetRegister(rn_or_immediate), true));
         }
     } else {
-        if (operand_is_immediate) {
+        if constexpr (operand_is_immediate) {
             SetRegister(rd, ADD(GetRegister(rs), rn_or_immediate, true));
         } else {
             SetRegister(rd, ADD(GetRegister(rs), GetRegister(rn_or_immediate), true));
         }
     }
 
-    timers.AdvanceCycles(1, Timers::CycleType::Sequential);
+    AddCycles(1, CycleType::Sequential);
 }
 
+template <u8 op>
 void ARM7::Thumb_MoveCompareAddSubtractImmediate(const u16 opcode) {
-    const std::unsigned_integral auto op = Common::GetBitRange<12, 11>(opcode);
     const std::unsigned_integral auto rd = Common::GetBitRange<10, 8>(opcode);
     const std::unsigned_integral auto offset = Common::GetBitRange<7, 0>(opcode);
 
     switch (op) {
         case 0x0:
             SetRegister(rd, offset);
-            cpsr.flags.negative = Common::IsBitSet<31>(GetRegister(rd));
-            cpsr.flags.zero = (GetRegister(rd) == 0);
+            SetNZ(Common::IsBitSet<31>(GetRegister(rd)), GetRegister(rd) == 0);
             break;
         case 0x1:
             CMP(GetRegister(rd), offset);
@@ -117,11 +75,11 @@ void ARM7::Thumb_MoveCompareAddSubtractImmediate(const u16 opcode) {
             UNREACHABLE_MSG("interpreter: illegal thumb MCASI op 0x{:X}", op);
     }
 
-    timers.AdvanceCycles(1, Timers::CycleType::Sequential);
+    AddCycles(1, CycleType::Sequential);
 }
 
+template <u8 op>
 void ARM7::Thumb_ALUOperations(const u16 opcode) {
-    const std::unsigned_integral auto op = Common::GetBitRange<9, 6>(opcode);
     const std::unsigned_integral auto rs = Common::GetBitRange<5, 3>(opcode);
     const std::unsigned_integral auto rd = Common::GetBitRange<2, 0>(opcode);
 
@@ -133,13 +91,13 @@ void ARM7::Thumb_ALUOperations(const u16 opcode) {
             SetRegister(rd, GetRegister(rd) ^ GetRegister(rs));
             break;
         case 0x2: // LSL
-            SetRegister(rd, Shift(GetRegister(rd), ShiftType::LSL, GetRegister(rs), true));
+            SetRegister(rd, Shift<ShiftType::LSL>(GetRegister(rd), GetRegister(rs), true));
             break;
         case 0x3: // LSR
-            SetRegister(rd, Shift(GetRegister(rd), ShiftType::LSR, GetRegister(rs), true));
+            SetRegister(rd, Shift<ShiftType::LSR>(GetRegister(rd), GetRegister(rs), true));
             break;
         case 0x4: // ASR
-            SetRegister(rd, Shift(GetRegister(rd), ShiftType::ASR, GetRegister(rs), true));
+            SetRegister(rd, Shift<ShiftType::ASR>(GetRegister(rd), GetRegister(rs), true));
             break;
         case 0x5: // ADC
             SetRegister(rd, ADC(GetRegister(rd), GetRegister(rs), true));
@@ -148,7 +106,7 @@ void ARM7::Thumb_ALUOperations(const u16 opcode) {
             SetRegister(rd, SBC(GetRegister(rd), GetRegister(rs), true));
             break;
         case 0x7: // ROR
-            SetRegister(rd, Shift(GetRegister(rd), ShiftType::ROR, GetRegister(rs), true));
+            SetRegister(rd, Shift<ShiftType::ROR>(GetRegister(rd), GetRegister(rs), true));
             break;
         case 0x8: // TST
             TST(GetRegister(rd), GetRegister(rs));
@@ -178,16 +136,13 @@ void ARM7::Thumb_ALUOperations(const u16 opcode) {
             UNREACHABLE();
     }
 
-    cpsr.flags.negative = Common::IsBitSet<31>(GetRegister(rd));
-    cpsr.flags.zero = (GetRegister(rd) == 0);
+    SetNZ(Common::IsBitSet<31>(GetRegister(rd)), GetRegister(rd) == 0);
 
-    timers.AdvanceCycles(1, Timers::CycleType::Sequential);
+    AddCycles(1, CycleType::Sequential);
 }
 
+template <u8 op, bool h1, bool h2>
 void ARM7::Thumb_HiRegisterOperationsBranchExchange(const u16 opcode) {
-    const std::unsigned_integral auto op = Common::GetBitRange<9, 8>(opcode);
-    const bool h1 = Common::IsBitSet<7>(opcode);
-    const bool h2 = Common::IsBitSet<6>(opcode);
     const std::unsigned_integral auto rs_hs = Common::GetBitRange<5, 3>(opcode) + (h2 ? 8u : 0u);
     const std::unsigned_integral auto rd_hd = Common::GetBitRange<2, 0>(opcode) + (h1 ? 8u : 0u);
 
@@ -221,8 +176,7 @@ void ARM7::Thumb_HiRegisterOperationsBranchExchange(const u16 opcode) {
             UNREACHABLE();
     }
 
-    cpsr.flags.negative = Common::IsBitSet<31>(GetRegister(rd_hd));
-    cpsr.flags.zero = (GetRegister(rd_hd) == 0);
+    SetNZ(Common::IsBitSet<31>(GetRegister(rd_hd)), GetRegister(rd_hd) == 0);
 }
 
 void ARM7::Thumb_PCRelativeLoad(const u16 opcode) {
@@ -232,9 +186,8 @@ void ARM7::Thumb_PCRelativeLoad(const u16 opcode) {
     SetRegister(rd, bus.Read32((GetPC() + (imm << 2)) & ~0x3));
 }
 
+template <bool load_from_memory, bool transfer_byte>
 void ARM7::Thumb_LoadStoreWithRegisterOffset(const u16 opcode) {
-    const bool load_from_memory = Common::IsBitSet<11>(opcode);
-    const bool transfer_byte = Common::IsBitSet<10>(opcode);
     const std::unsigned_integral auto ro = Common::GetBitRange<8, 6>(opcode);
     const std::unsigned_integral auto rb = Common::GetBitRange<5, 3>(opcode);
     const std::unsigned_integral auto rd = Common::GetBitRange<2, 0>(opcode);
@@ -242,8 +195,8 @@ void ARM7::Thumb_LoadStoreWithRegisterOffset(const u16 opcode) {
     const u32 address = GetRegister(rb) + GetRegister(ro);
     const bool address_is_word_aligned = ((address & 0b11) == 0);
 
-    if (load_from_memory) {
-        if (transfer_byte) {
+    if constexpr (load_from_memory) {
+        if constexpr (transfer_byte) {
             SetRegister(rd, bus.Read8(address));
         } else {
             if (address_is_word_aligned) {
@@ -254,7 +207,7 @@ void ARM7::Thumb_LoadStoreWithRegisterOffset(const u16 opcode) {
             }
         }
     } else {
-        if (transfer_byte) {
+        if constexpr (transfer_byte) {
             bus.Write8(address, GetRegister(rd));
         } else {
             if (address_is_word_aligned) {
@@ -266,15 +219,14 @@ void ARM7::Thumb_LoadStoreWithRegisterOffset(const u16 opcode) {
     }
 }
 
+template <bool h_flag, bool sign_extend>
 void ARM7::Thumb_LoadStoreSignExtendedByteHalfword(const u16 opcode) {
-    const bool h_flag = Common::IsBitSet<11>(opcode);
-    const bool sign_extend = Common::IsBitSet<10>(opcode);
     const std::unsigned_integral auto ro = Common::GetBitRange<8, 6>(opcode);
     const std::unsigned_integral auto rb = Common::GetBitRange<5, 3>(opcode);
     const std::unsigned_integral auto rd = Common::GetBitRange<2, 0>(opcode);
 
-    if (sign_extend) {
-        if (h_flag) {
+    if constexpr (sign_extend) {
+        if constexpr (h_flag) {
             s32 rd_se = bus.Read16(GetRegister(rb) + GetRegister(ro));
             rd_se <<= 16;
             rd_se >>= 16;
@@ -286,7 +238,7 @@ void ARM7::Thumb_LoadStoreSignExtendedByteHalfword(const u16 opcode) {
             SetRegister(rd, rd_se);
         }
     } else {
-        if (h_flag) {
+        if constexpr (h_flag) {
             SetRegister(rd, bus.Read16(GetRegister(rb) + GetRegister(ro)));
         } else {
             bus.Write16(GetRegister(rb) + GetRegister(ro), GetRegister(rd));
@@ -294,18 +246,16 @@ void ARM7::Thumb_LoadStoreSignExtendedByteHalfword(const u16 opcode) {
     }
 }
 
+template <bool transfer_byte, bool load_from_memory>
 void ARM7::Thumb_LoadStoreWithImmediateOffset(const u16 opcode) {
-    const bool transfer_byte = Common::IsBitSet<12>(opcode);
-    const bool load_from_memory = Common::IsBitSet<11>(opcode);
-
-    if (transfer_byte) {
-        if (load_from_memory) {
+    if constexpr (transfer_byte) {
+        if constexpr (load_from_memory) {
             Thumb_LoadByteWithImmediateOffset(opcode);
         } else {
             Thumb_StoreByteWithImmediateOffset(opcode);
         }
     } else {
-        if (load_from_memory) {
+        if constexpr (load_from_memory) {
             Thumb_LoadWordWithImmediateOffset(opcode);
         } else {
             Thumb_StoreWordWithImmediateOffset(opcode);
@@ -354,40 +304,40 @@ void ARM7::Thumb_LoadWordWithImmediateOffset(const u16 opcode) {
     }
 }
 
+template <bool load_from_memory>
 void ARM7::Thumb_LoadStoreHalfword(const u16 opcode) {
-    const bool load_from_memory = Common::IsBitSet<11>(opcode);
     const std::unsigned_integral auto imm = Common::GetBitRange<10, 6>(opcode);
     const std::unsigned_integral auto rb = Common::GetBitRange<5, 3>(opcode);
     const std::unsigned_integral auto rd = Common::GetBitRange<2, 0>(opcode);
 
     const u32 address = GetRegister(rb) + (imm << 1);
 
-    if (load_from_memory) {
+    if constexpr (load_from_memory) {
         SetRegister(rd, bus.Read16(address));
     } else {
         bus.Write16(address, static_cast<u16>(GetRegister(rd)));
     }
 }
 
+template <bool load_from_memory>
 void ARM7::Thumb_SPRelativeLoadStore(const u16 opcode) {
-    const bool load_from_memory = Common::IsBitSet<11>(opcode);
     const std::unsigned_integral auto rd = Common::GetBitRange<10, 8>(opcode);
     const std::unsigned_integral auto imm = Common::GetBitRange<7, 0>(opcode);
 
-    if (load_from_memory) {
+    if constexpr (load_from_memory) {
         SetRegister(rd, bus.Read32(GetSP() + (imm << 2)));
     } else {
         bus.Write32(GetSP() + (imm << 2), GetRegister(rd));
     }
 }
 
+template <bool load_from_sp>
 void ARM7::Thumb_LoadAddress(const u16 opcode) {
-    const bool load_from_sp = Common::IsBitSet<11>(opcode);
     const std::unsigned_integral auto rd = Common::GetBitRange<10, 8>(opcode);
     const std::unsigned_integral auto imm = Common::GetBitRange<7, 0>(opcode);
 
     u32 address = 0;
-    if (load_from_sp) {
+    if constexpr (load_from_sp) {
         address = GetSP();
     } else {
         address = GetPC() & ~0b11;
@@ -397,20 +347,19 @@ void ARM7::Thumb_LoadAddress(const u16 opcode) {
     SetRegister(rd, address + offset);
 }
 
+template <bool offset_is_negative>
 void ARM7::Thumb_AddOffsetToStackPointer(const u16 opcode) {
-    const bool offset_is_negative = Common::IsBitSet<7>(opcode);
     const std::unsigned_integral auto imm = Common::GetBitRange<6, 0>(opcode);
 
-    if (offset_is_negative) {
+    if constexpr (offset_is_negative) {
         SetSP(GetSP() - (imm << 2));
     } else {
         SetSP(GetSP() + (imm << 2));
     }
 }
 
+template <bool load_from_memory, bool store_lr_load_pc>
 void ARM7::Thumb_PushPopRegisters(const u16 opcode) {
-    const bool load_from_memory = Common::IsBitSet<11>(opcode);
-    const bool store_lr_load_pc = Common::IsBitSet<8>(opcode);
     const std::unsigned_integral auto rlist = Common::GetBitRange<7, 0>(opcode);
 
     // Go through `rlist`'s 8 bits, and write down which bits are set. This tells
@@ -423,11 +372,11 @@ void ARM7::Thumb_PushPopRegisters(const u16 opcode) {
                         | ranges::to<std::vector>;
 
     if (set_bits.empty()) {
-        if (!store_lr_load_pc) {
+        if constexpr (!store_lr_load_pc) {
             return;
         }
 
-        if (load_from_memory) {
+        if constexpr (load_from_memory) {
             SetPC(bus.Read32(GetSP()) & ~0b1);
             SetSP(GetSP() + 4);
         } else {
@@ -438,18 +387,18 @@ void ARM7::Thumb_PushPopRegisters(const u16 opcode) {
         return;
     }
 
-    if (load_from_memory) {
+    if constexpr (load_from_memory) {
         for (u8 reg : set_bits) {
             SetRegister(reg, bus.Read32(GetSP()));
             SetSP(GetSP() + 4);
         }
 
-        if (store_lr_load_pc) {
+        if constexpr (store_lr_load_pc) {
             SetPC(bus.Read32(GetSP()) & ~0b1);
             SetSP(GetSP() + 4);
         }
     } else {
-        if (store_lr_load_pc) {
+        if constexpr (store_lr_load_pc) {
             SetSP(GetSP() - 4);
             bus.Write32(GetSP(), GetLR());
         }
@@ -461,8 +410,8 @@ void ARM7::Thumb_PushPopRegisters(const u16 opcode) {
     }
 }
 
+template <bool load_from_memory>
 void ARM7::Thumb_MultipleLoadStore(const u16 opcode) {
-    const bool load_from_memory = Common::IsBitSet<11>(opcode);
     const std::unsigned_integral auto rb = Common::GetBitRange<10, 8>(opcode);
     const std::unsigned_integral auto rlist = Common::GetBitRange<7, 0>(opcode);
 
@@ -479,7 +428,7 @@ void ARM7::Thumb_MultipleLoadStore(const u16 opcode) {
         return;
     }
 
-    if (load_from_memory) {
+    if constexpr (load_from_memory) {
         for (u8 i : set_bits) {
             SetRegister(i, bus.Read32(GetRegister(rb)));
             SetRegister(rb, GetRegister(rb) + 4);
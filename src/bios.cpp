@@ -11,5 +11,5 @@ BIOS::BIOS(const std::filesystem::path& bios_filename) {
     std::ifstream stream(bios_filename, std::ios::binary);
     ASSERT_MSG(stream.is_open(), "Could not open provided BIOS");
 
-    stream.read(reinterpret_cast<char*>(bios.data()), file_size);
+    stream.read(reinterpret_cast<char*>(bios.GetData()), file_size);
 }
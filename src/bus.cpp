@@ -2,72 +2,113 @@
 #include "bus.h"
 #include "common/bits.h"
 #include "common/logging.h"
+#include "scheduler.h"
+#include "timer.h"
 
-Bus::Bus(BIOS& bios_, Cartridge& cartridge_, Keypad& keypad_, PPU& ppu_, Interrupts& interrupts_, ARM7& arm7_, Timers& timers_)
-    : bios(bios_), cartridge(cartridge_), keypad(keypad_), ppu(ppu_), interrupts(interrupts_), arm7(arm7_), timers(timers_) {
+Bus::Bus(BIOS& bios_, Cartridge& cartridge_, Keypad& keypad_, PPU& ppu_, Interrupts& interrupts_, ARM7& arm7_, Timers& timers_, Scheduler& scheduler_)
+    : bios(bios_), cartridge(cartridge_), keypad(keypad_), ppu(ppu_), interrupts(interrupts_), arm7(arm7_), timers(timers_), scheduler(scheduler_) {
+    MapPages();
 }
 
-u8 Bus::Read8(u32 addr) {
-    const u32 masked_addr = addr & 0x0FFFFFFF;
-    switch ((masked_addr >> 24) & 0xF) {
-        case 0x0:
-            return bios.Read<u8>(masked_addr & 0x3FFF);
-
-        case 0x2: {
-            u8 value = wram_onboard.at(masked_addr & 0x3FFFF);
-            LDEBUG("read8 0x{:02X} from 0x{:08X} (WRAM onboard)", value, masked_addr);
-            return value;
+void Bus::MapPages() {
+    for (std::size_t i = 0; i < PAGE_COUNT; i++) {
+        const u32 page_addr = static_cast<u32>(i << PAGE_BITS);
+        Page<u8*> page;
+
+        switch (page_addr >> 24) {
+            case 0x0:
+                read_pages[i] = {bios.GetData(), bios.GetMirrorMask()};
+                continue;
+            case 0x2:
+                page = {wram_onboard.GetData(), wram_onboard.GetMirrorMask()};
+                break;
+            case 0x3:
+                page = {wram_onchip.GetData(), wram_onchip.GetMirrorMask()};
+                break;
+            case 0x5:
+                page = {ppu.pram.GetData(), ppu.pram.GetMirrorMask()};
+                break;
+            case 0x6: {
+                // The upper 32 KB of each 128 KB mirror repeats the last 32 KB of VRAM.
+                u32 offset = page_addr & 0x1FFFF;
+                if (offset > 0x17FFF) {
+                    offset -= 0x8000;
+                }
+                page = {ppu.vram.GetData() + offset, PAGE_SIZE - 1};
+                break;
+            }
+            case 0x7:
+                page = {ppu.oam.GetData(), ppu.oam.GetMirrorMask()};
+                break;
+            case 0x8:
+            case 0x9:
+            case 0xA:
+            case 0xB:
+            case 0xC:
+            case 0xD: {
+                // This includes the open bus values past the end of the ROM.
+                read_pages[i] = {cartridge.GetHostPointer(page_addr), PAGE_SIZE - 1};
+                continue;
+            }
+            default:
+                continue;
         }
 
-        case 0x3: {
-            u8 value = wram_onchip.at(masked_addr & 0x7FFF);
-            LDEBUG("read8 0x{:02X} from 0x{:08X} (WRAM on-chip)", value, masked_addr);
-            return value;
-        }
+        read_pages[i] = {page.pointer, page.mask};
+        write_pages[i] = page;
+    }
+}
 
-        case 0x4:
-            switch (masked_addr) {
-                case 0x4000006:
-                    return ppu.GetVCOUNT();
-                case 0x4000130:
-                    return keypad.GetState();
-                case 0x4000300:
-                    return post_flg;
-                default:
-                    LERROR("unrecognized read8 from IO register 0x{:08X}", masked_addr);
-                    return 0xFF;
-            }
+Bus::HostRegion<> Bus::GetHostRegion(const u32 addr) const {
+    return GetHostRegion(read_pages, addr);
+}
 
-            return 0xFF;
+template <typename Pointer>
+Bus::HostRegion<Pointer> Bus::GetHostRegion(const std::array<Page<Pointer>, PAGE_COUNT>& pages, const u32 addr) {
+    const Page<Pointer>& page = pages[GetPageIndex(addr)];
+    if (!page.pointer) {
+        return {};
+    }
 
-        case 0x5:
-            return ppu.ReadPRAM<u8>(masked_addr & 0x3FF);
+    // The mask is either the size of a page or of a mirror, and every page a mirror spans
+    // points at the same memory, so the region covers whatever the mask covers.
+    return {addr & ~page.mask, page.mask + 1, page.pointer};
+}
 
-        case 0x6: {
-            u32 address = masked_addr & 0x1FFFF;
-            if (address > 0x17FFF) {
-                address -= 0x8000;
-            }
+template <UnsignedIntegerMax32 T>
+bool Bus::WriteToPage(const u32 addr, const T value) {
+    const u32 aligned_addr = addr & ~static_cast<u32>(sizeof(T) - 1);
+    const u8 region = (aligned_addr >> 24) & 0xF;
 
-            u8 value = ppu.ReadVRAM<u8>(address);
-            LDEBUG("read8 0x{:02X} from 0x{:08X} (VRAM)", value, masked_addr);
-            return value;
+    if constexpr (std::is_same_v<T, u8>) {
+        // 8-bit writes to PRAM, VRAM and OAM don't behave like plain stores.
+        if (region != 0x2 && region != 0x3) {
+            return false;
         }
+    }
 
-        case 0x7:
-            return ppu.ReadOAM<u8>(masked_addr & 0x3FF);
+    const Page<u8*>& page = write_pages[GetPageIndex(aligned_addr)];
+    if (!page.pointer) {
+        return false;
+    }
 
-        case 0x8:
-        case 0x9:
-        case 0xA:
-        case 0xB:
-        case 0xC:
-        case 0xD:
-            if ((masked_addr & 0x1FFFFFF) >= cartridge.GetSize()) {
-                // TODO: open bus?
-                return 0;
-            }
-            return cartridge.Read<u8>(masked_addr & 0x1FFFFFF);
+    u8* pointer = page.pointer + (aligned_addr & page.mask);
+    std::memcpy(pointer, &value, sizeof(T));
+
+    if (region == 0x2 || region == 0x3) {
+        arm7.InvalidateBlocks(addr & 0x0FFFFFFF);
+    } else if (region == 0x6) {
+        ppu.InvalidateTiles(pointer - ppu.vram.GetData());
+    }
+
+    return true;
+}
+
+u8 Bus::SlowRead8(u32 addr) {
+    const u32 masked_addr = addr & 0x0FFFFFFF;
+    switch ((masked_addr >> 24) & 0xF) {
+        case 0x4:
+            return ReadIO<u8>(masked_addr);
 
         case 0xE:
             if (masked_addr == 0xE000000) {
@@ -87,58 +128,20 @@ u8 Bus::Read8(u32 addr) {
 }
 
 void Bus::Write8(u32 addr, u8 value) {
-    const u32 masked_addr = addr & 0x0FFFFFFF;
-    switch ((masked_addr >> 24) & 0xF) {
-        case 0x2:
-            LDEBUG("write8 0x{:02X} to 0x{:08X} (WRAM onboard)", value, masked_addr);
-            wram_onboard[masked_addr & 0x3FFFF] = value;
-            return;
+    write_count++;
 
-        case 0x3:
-            LDEBUG("write8 0x{:02X} to 0x{:08X} (WRAM on-chip)", value, masked_addr);
-            wram_onchip[masked_addr & 0x7FFF] = value;
-            return;
+    if (WriteToPage(addr, value)) {
+        return;
+    }
 
+    const u32 masked_addr = addr & 0x0FFFFFFF;
+    switch ((masked_addr >> 24) & 0xF) {
         case 0x4:
-            switch (masked_addr) {
-                case 0x4000000:
-                    ppu.SetDISPCNT((ppu.GetDISPCNT() & 0xFF00) | value);
-                    return;
-                case 0x4000001:
-                    ppu.SetDISPCNT((ppu.GetDISPCNT() & 0x00FF) | (value << 8));
-                    return;
-                case 0x4000008:
-                    ppu.SetBGCNT<0>((ppu.GetBGCNT<0>() & ~0xFF) | value);
-                    return;
-                case 0x4000010:
-                    ppu.SetBGXOffset<0>(value);
-                    return;
-                case 0x4000012:
-                    ppu.SetBGYOffset<0>(value);
-                    return;
-                case 0x4000202:
-                    interrupts.SetIF(value);
-                    return;
-                case 0x4000208:
-                    interrupts.SetIME(Common::IsBitSet<0>(value));
-                    return;
-                case 0x4000300:
-                    post_flg = Common::IsBitSet<0>(value);
-                    return;
-                case 0x4000301:
-                    if (!Common::IsBitSet<7>(value)) {
-                        arm7.halted = true;
-                    } else {
-                        // TODO: Stop mode
-                    }
-                    return;
-                default:
-                    LERROR("unrecognized write8 0x{:02X} to IO register 0x{:08X}", value, masked_addr);
-                    return;
-            }
+            WriteIO<u8>(masked_addr, value);
+            return;
 
         case 0x5:
-            ppu.WritePRAM<u8>(masked_addr & 0x3FF, value);
+            ppu.pram.Write<u8>(masked_addr, value);
             return;
 
         case 0x6: {
@@ -148,12 +151,14 @@ void Bus::Write8(u32 addr, u8 value) {
             }
 
             LDEBUG("write8 0x{:02X} to 0x{:08X} (VRAM)", value, masked_addr);
-            ppu.WriteVRAM<u8>(address, value);
+            ppu.vram.Write<u8>(address, value);
+            ppu.InvalidateTiles(address);
             return;
         }
 
         case 0x7:
-            // Can't write 8bit data to OAM.
+            // OAM ignores 8-bit writes.
+            ppu.oam.Write<u8>(masked_addr, value);
             return;
 
         default:
@@ -162,121 +167,11 @@ void Bus::Write8(u32 addr, u8 value) {
     }
 }
 
-u16 Bus::Read16(u32 addr) {
+u16 Bus::SlowRead16(u32 addr) {
     const u32 masked_addr = addr & 0x0FFFFFFF;
     switch ((masked_addr >> 24) & 0xF) {
-        case 0x0:
-            return bios.Read<u16>(masked_addr & 0x3FFF);
-
-        case 0x2: {
-            u16 value = 0;
-            for (std::size_t i = 0; i < 2; i++) {
-                // Mask off the last bit to keep halfword alignment.
-                value |= ((wram_onboard.at(((masked_addr & ~0b1) & 0x3FFFF) + i)) & 0xFF) << (8 * i);
-            }
-
-            LDEBUG("read16 0x{:04X} from 0x{:08X} (WRAM onboard)", value, masked_addr);
-            return value;
-        }
-
-        case 0x3: {
-            u16 value = 0;
-            for (std::size_t i = 0; i < 2; i++) {
-                // Mask off the last bit to keep halfword alignment.
-                value |= ((wram_onchip.at(((masked_addr & ~0b1) & 0x7FFF) + i)) & 0xFF) << (8 * i);
-            }
-
-            LDEBUG("read16 0x{:04X} from 0x{:08X} (WRAM on-chip)", value, masked_addr);
-            return value;
-        }
-
         case 0x4:
-            switch (masked_addr) {
-                case 0x4000000:
-                    return ppu.GetDISPCNT();
-                case 0x4000004:
-                    return ppu.GetDISPSTAT();
-                case 0x4000006:
-                    return ppu.GetVCOUNT();
-                case 0x4000008:
-                    return ppu.GetBGCNT<0>();
-                case 0x400000A:
-                    return ppu.GetBGCNT<1>();
-                case 0x400000C:
-                    return ppu.GetBGCNT<2>();
-                case 0x400000E:
-                    return ppu.GetBGCNT<3>();
-                case 0x40000B8:
-                    return 0;
-                case 0x40000BA:
-                    return dma_channels[0].control.raw;
-                case 0x40000C4:
-                    return 0;
-                case 0x40000C6:
-                    return dma_channels[1].control.raw;
-                case 0x40000D0:
-                    return 0;
-                case 0x40000D2:
-                    return dma_channels[2].control.raw;
-                case 0x40000DC:
-                    return 0;
-                case 0x40000DE:
-                    return dma_channels[3].control.raw;
-                case 0x4000100:
-                    return timers.timer0.GetCounter();
-                case 0x4000102:
-                    return timers.timer0.GetControl();
-                case 0x4000104:
-                    return timers.timer1.GetCounter();
-                case 0x4000106:
-                    return timers.timer1.GetControl();
-                case 0x4000108:
-                    return timers.timer2.GetCounter();
-                case 0x400010C:
-                    return timers.timer3.GetControl();
-                case 0x4000130:
-                    return keypad.GetState();
-                case 0x4000200:
-                    return interrupts.GetIE();
-                case 0x4000202:
-                    return interrupts.GetIF();
-                case 0x4000204:
-                    return timers.GetWaitstateControl();
-                case 0x4000208:
-                    return interrupts.GetIME();
-                default:
-                    LERROR("unrecognized read16 from IO register 0x{:08X}", masked_addr);
-                    return 0xFFFF;
-            }
-
-        case 0x5:
-            return ppu.ReadPRAM<u16>(masked_addr & 0x3FF);
-
-        case 0x6: {
-            u32 address = masked_addr & 0x1FFFF;
-            if (address > 0x17FFF) {
-                address -= 0x8000;
-            }
-
-            u16 value = ppu.ReadVRAM<u16>(address);
-            LDEBUG("read16 0x{:04X} from 0x{:08X} (VRAM)", value, masked_addr);
-            return value;
-        }
-
-        case 0x7:
-            return ppu.ReadOAM<u16>(masked_addr & 0x3FF);
-
-        case 0x8:
-        case 0x9:
-        case 0xA:
-        case 0xB:
-        case 0xC:
-        case 0xD:
-            if ((masked_addr & 0x1FFFFFF) >= cartridge.GetSize()) {
-                // TODO: open bus?
-                return 0;
-            }
-            return cartridge.Read<u16>(masked_addr & 0x1FFFFFF);
+            return ReadIO<u16>(masked_addr);
 
         default:
             LERROR("unrecognized read16 from 0x{:08X}", addr);
@@ -285,416 +180,333 @@ u16 Bus::Read16(u32 addr) {
 }
 
 void Bus::Write16(u32 addr, u16 value) {
+    write_count++;
+
+    if (WriteToPage(addr, value)) {
+        return;
+    }
+
     const u32 masked_addr = addr & 0x0FFFFFFF;
     switch ((masked_addr >> 24) & 0xF) {
-        case 0x2:
-            LDEBUG("write16 0x{:04X} to 0x{:08X} (WRAM onboard)", value, masked_addr);
-            for (size_t i = 0; i < 2; i++) {
-                // Mask off the last bit to keep halfword alignment.
-                wram_onboard[((masked_addr & ~0b1) & 0x3FFFF) + i] = (value >> (8 * i)) & 0xFF;
-            }
+        case 0x4:
+            WriteIO<u16>(masked_addr, value);
             return;
 
-        case 0x3:
-            LDEBUG("write16 0x{:04X} to 0x{:08X} (WRAM on-chip)", value, masked_addr);
-            for (size_t i = 0; i < 2; i++) {
-                // Mask off the last bit to keep halfword alignment.
-                wram_onchip[((masked_addr & ~0b1) & 0x7FFF) + i] = (value >> (8 * i)) & 0xFF;
-            }
+        default:
+            LERROR("unrecognized write16 0x{:04X} to 0x{:08X}", value, addr);
             return;
+    }
+}
 
+u32 Bus::SlowRead32(u32 addr) {
+    const u32 masked_addr = addr & 0x0FFFFFFF;
+    switch ((masked_addr >> 24) & 0xF) {
         case 0x4:
-            switch (masked_addr) {
-                case 0x4000000:
-                    ppu.SetDISPCNT(value);
-                    return;
-                case 0x4000004:
-                    ppu.SetDISPSTAT(value);
-                    return;
-                case 0x4000008:
-                    ppu.SetBGCNT<0>(value);
-                    return;
-                case 0x400000A:
-                    ppu.SetBGCNT<1>(value);
-                    return;
-                case 0x400000C:
-                    ppu.SetBGCNT<2>(value);
-                    return;
-                case 0x400000E:
-                    ppu.SetBGCNT<3>(value);
-                    return;
-                case 0x4000010:
-                    ppu.SetBGXOffset<0>(value);
-                    return;
-                case 0x4000012:
-                    ppu.SetBGYOffset<0>(value);
-                    return;
-                case 0x4000014:
-                    ppu.SetBGXOffset<1>(value);
-                    return;
-                case 0x4000016:
-                    ppu.SetBGYOffset<1>(value);
-                    return;
-                case 0x4000018:
-                    ppu.SetBGXOffset<2>(value);
-                    return;
-                case 0x400001A:
-                    ppu.SetBGYOffset<2>(value);
-                    return;
-                case 0x400001C:
-                    ppu.SetBGXOffset<3>(value);
-                    return;
-                case 0x400001E:
-                    ppu.SetBGYOffset<3>(value);
-                    return;
-                case 0x40000B8:
-                    dma_channels[0].word_count = value;
-                    return;
-                case 0x40000BA:
-                    SetDMAControl<0>(value);
-                    return;
-                case 0x40000C4:
-                    dma_channels[1].word_count = value;
-                    return;
-                case 0x40000C6:
-                    SetDMAControl<1>(value);
-                    return;
-                case 0x40000D0:
-                    dma_channels[2].word_count = value;
-                    return;
-                case 0x40000D2:
-                    SetDMAControl<2>(value);
-                    return;
-                case 0x40000DC:
-                    dma_channels[3].word_count = value;
-                    return;
-                case 0x40000DE:
-                    SetDMAControl<3>(value);
-                    return;
-                case 0x4000100:
-                    timers.timer0.SetReload(value);
-                    return;
-                case 0x4000102:
-                    timers.timer0.SetControl(value);
-                    return;
-                case 0x4000104:
-                    timers.timer1.SetReload(value);
-                    return;
-                case 0x4000106:
-                    timers.timer1.SetControl(value);
-                    return;
-                case 0x4000108:
-                    timers.timer2.SetReload(value);
-                    return;
-                case 0x400010A:
-                    timers.timer2.SetControl(value);
-                    return;
-                case 0x400010C:
-                    timers.timer3.SetReload(value);
-                    return;
-                case 0x400010E:
-                    timers.timer3.SetControl(value);
-                    return;
-                case 0x4000200:
-                    interrupts.SetIE(value);
-                    return;
-                case 0x4000202:
-                    interrupts.SetIF(value);
-                    return;
-                case 0x4000204:
-                    timers.SetWaitstateControl(value);
-                    return;
-                case 0x4000208:
-                    interrupts.SetIME(Common::IsBitSet<0>(value));
-                    return;
-                case 0x4000301:
-                    post_flg = Common::IsBitSet<0>(value);
-                    if (!Common::IsBitSet<15>(value)) {
-                        arm7.halted = true;
-                    } else {
-                        // TODO: stop mode
-                    }
-                    return;
-                default:
-                    LERROR("unrecognized write16 0x{:04X} to IO register 0x{:08X}", value, masked_addr);
-                    return;
-            }
+            return ReadIO<u32>(masked_addr);
 
-        case 0x5:
-            LDEBUG("write16 0x{:04X} to 0x{:08X} (PRAM)", value, masked_addr);
-            ppu.WritePRAM<u16>(masked_addr & 0x3FF, value);
-            return;
+        default:
+            LERROR("unrecognized read32 from 0x{:08X}", addr);
+            return 0xFFFFFFFF;
+    }
+}
 
-        case 0x6: {
-            u32 address = masked_addr & 0x1FFFF;
-            if (address > 0x17FFF) {
-                address -= 0x8000;
-            }
+void Bus::Write32(u32 addr, u32 value) {
+    write_count++;
 
-            LDEBUG("write16 0x{:04X} to 0x{:08X} (VRAM)", value, masked_addr);
-            ppu.WriteVRAM<u16>(address, value);
+    if (WriteToPage(addr, value)) {
+        return;
+    }
+
+    const u32 masked_addr = addr & 0x0FFFFFFF;
+    switch ((masked_addr >> 24) & 0xF) {
+        case 0x4:
+            WriteIO<u32>(masked_addr, value);
             return;
-        }
 
-        case 0x7:
-            ppu.WriteOAM<u16>(masked_addr & 0x3FF, value);
+        case 0x8:
+            // LWARN("tried to write32 0x{:08X} to 0x{:08X} (cartridge space)", value, masked_addr);
             return;
 
         default:
-            LERROR("unrecognized write16 0x{:04X} to 0x{:08X}", value, addr);
-            return;
+            LERROR("unrecognized write32 0x{:08X} to 0x{:08X}", value, addr);
     }
 }
 
-u32 Bus::Read32(u32 addr) {
-    const u32 masked_addr = addr & 0x0FFFFFFF;
-    switch ((masked_addr >> 24) & 0xF) {
-        case 0x0:
-            return bios.Read<u32>(masked_addr & 0x3FFF);
-
-        case 0x2: {
-            u32 value = 0;
-            for (std::size_t i = 0; i < 4; i++) {
-                // Mask off the last 2 bits to keep word alignment.
-                value |= ((wram_onboard.at(((masked_addr & ~0b11) & 0x3FFFF) + i)) & 0xFF) << (8 * i);
-            }
+template <UnsignedIntegerMax32 T>
+T Bus::ReadIO(const u32 addr) {
+    const u32 offset = addr & 0xFFFFFF & ~static_cast<u32>(sizeof(T) - 1);
+    const std::size_t index = offset >> 1;
 
-            LDEBUG("read32 0x{:08X} from 0x{:08X} (WRAM onboard)", value, masked_addr);
-            return value;
-        }
+    if constexpr (std::is_same_v<T, u8>) {
+        return ReadIORegister(index) >> ((offset & 1) * 8);
+    } else if constexpr (std::is_same_v<T, u16>) {
+        return ReadIORegister(index);
+    } else {
+        return ReadIORegister(index) | (ReadIORegister(index + 1) << 16);
+    }
+}
 
-        case 0x3: {
-            u32 value = 0;
-            for (std::size_t i = 0; i < 4; i++) {
-                // Mask off the last 2 bits to keep word alignment.
-                value |= ((wram_onchip.at(((masked_addr & ~0b11) & 0x7FFF) + i)) & 0xFF) << (8 * i);
-            }
+template <UnsignedIntegerMax32 T>
+void Bus::WriteIO(const u32 addr, const T value) {
+    const u32 offset = addr & 0xFFFFFF & ~static_cast<u32>(sizeof(T) - 1);
+    const std::size_t index = offset >> 1;
 
-            LDEBUG("read32 0x{:08X} from 0x{:08X} (WRAM on-chip)", value, masked_addr);
-            return value;
-        }
+    if constexpr (std::is_same_v<T, u8>) {
+        const u32 shift = (offset & 1) * 8;
+        WriteIORegister(index, value << shift, 0xFF << shift);
+    } else if constexpr (std::is_same_v<T, u16>) {
+        WriteIORegister(index, value, 0xFFFF);
+    } else {
+        WriteIORegister(index, Common::GetBitRange<15, 0>(value), 0xFFFF);
+        WriteIORegister(index + 1, Common::GetBitRange<31, 16>(value), 0xFFFF);
+    }
+}
 
-        case 0x4:
-            switch (masked_addr) {
-                case 0x4000000:
-                    // TODO: green swap
-                    return (0xFFFF << 16) | ppu.GetDISPCNT();
-                case 0x4000004:
-                    return ppu.GetDISPSTAT();
-                case 0x40000B8:
-                    return dma_channels[0].control.raw << 16;
-                case 0x40000C4:
-                    return dma_channels[1].control.raw << 16;
-                case 0x40000D0:
-                    return dma_channels[2].control.raw << 16;
-                case 0x40000DC:
-                    return dma_channels[3].control.raw << 16;
-                case 0x4000100:
-                    return (timers.timer0.GetControl() << 16) | timers.timer0.GetCounter();
-                case 0x4000104:
-                    return (timers.timer1.GetControl() << 16) | timers.timer1.GetCounter();
-                case 0x4000130:
-                    return keypad.GetState();
-                case 0x4000200:
-                    return interrupts.GetIE() | (interrupts.GetIF() << 16);
-                case 0x4000208:
-                    return interrupts.GetIME();
-                default:
-                    LERROR("unrecognized read32 from IO register 0x{:08X}", masked_addr);
-                    return 0xFFFFFFFF;
-            }
+u16 Bus::ReadIORegister(const std::size_t index) {
+    const IORegister* io_register = index < IO_REGISTER_COUNT ? &io_register_table[index] : nullptr;
+    if (!io_register || (!io_register->read && !io_register->write)) {
+        LERROR("unrecognized read from IO register 0x{:08X}", 0x4000000 + index * 2);
+        return 0xFFFF;
+    }
 
-        case 0x5:
-            return ppu.ReadPRAM<u32>(masked_addr & 0x3FF);
+    if (!io_register->read) {
+        return io_registers[index];
+    }
 
-        case 0x6: {
-            u32 address = masked_addr & 0x1FFFF;
-            if (address > 0x17FFF) {
-                address -= 0x8000;
-            }
+    return io_register->read(*this, io_registers[index]);
+}
 
-            u32 value = ppu.ReadVRAM<u32>(address);
-            LDEBUG("read32 0x{:08X} from 0x{:08X} (VRAM)", value, masked_addr);
-            return value;
-        }
+void Bus::WriteIORegister(const std::size_t index, const u16 value, const u16 mask) {
+    const IORegister* io_register = index < IO_REGISTER_COUNT ? &io_register_table[index] : nullptr;
+    if (!io_register || (!io_register->read && !io_register->write)) {
+        LERROR("unrecognized write 0x{:04X} (mask 0x{:04X}) to IO register 0x{:08X}", value, mask, 0x4000000 + index * 2);
+        return;
+    }
 
-        case 0x7:
-            return ppu.ReadOAM<u32>(masked_addr & 0x3FF);
+    if (!io_register->write) {
+        return;
+    }
 
-        case 0x8:
-        case 0x9:
-        case 0xA:
-        case 0xB:
-        case 0xC:
-        case 0xD:
-            if ((masked_addr & 0x1FFFFFF) >= cartridge.GetSize()) {
-                // TODO: open bus?
-                return 0;
-            }
-            return cartridge.Read<u32>(masked_addr & 0x1FFFFFF);
+    io_registers[index] = (io_registers[index] & ~mask) | (value & mask);
+    io_register->write(*this, io_registers[index], mask);
+}
 
-        default:
-            LERROR("unrecognized read32 from 0x{:08X}", addr);
-            return 0xFFFFFFFF;
+template <u8 timer_no>
+Timer& Bus::GetTimer() {
+    static_assert(timer_no < 4);
+
+    if constexpr (timer_no == 0) {
+        return timers.timer0;
+    } else if constexpr (timer_no == 1) {
+        return timers.timer1;
+    } else if constexpr (timer_no == 2) {
+        return timers.timer2;
+    } else {
+        return timers.timer3;
     }
 }
 
-void Bus::Write32(u32 addr, u32 value) {
-    const u32 masked_addr = addr & 0x0FFFFFFF;
-    switch ((masked_addr >> 24) & 0xF) {
-        case 0x2:
-            // LDEBUG("write32 0x{:08X} to 0x{:08X} (WRAM onboard)", value, masked_addr);
-            for (size_t i = 0; i < 4; i++) {
-                // Mask off the last 2 bits to keep word alignment.
-                wram_onboard[((masked_addr & ~0b11) & 0x3FFFF) + i] = (value >> (8 * i)) & 0xFF;
-            }
-            return;
-
-        case 0x3:
-            LDEBUG("write32 0x{:08X} to 0x{:08X} (WRAM on-chip)", value, masked_addr);
-            for (size_t i = 0; i < 4; i++) {
-                // Mask off the last 2 bits to keep word alignment.
-                wram_onchip[((masked_addr & ~0b11) & 0x7FFF) + i] = (value >> (8 * i)) & 0xFF;
-            }
-            return;
+// Write-only registers read back as zero.
+static constexpr u16 ReadWriteOnlyIORegister(Bus&, u16) {
+    return 0;
+}
 
-        case 0x4:
-            switch (masked_addr) {
-                case 0x4000000:
-                    ppu.SetDISPCNT(value);
-                    return;
-                case 0x4000004:
-                    ppu.SetDISPSTAT(Common::GetBitRange<15, 0>(value));
-                    return;
-                case 0x4000008:
-                    ppu.SetBGCNT<0>(Common::GetBitRange<15, 0>(value));
-                    ppu.SetBGCNT<1>(Common::GetBitRange<31, 16>(value));
-                    return;
-                case 0x400000C:
-                    ppu.SetBGCNT<2>(Common::GetBitRange<15, 0>(value));
-                    ppu.SetBGCNT<3>(Common::GetBitRange<31, 16>(value));
-                    return;
-                case 0x4000010:
-                    ppu.SetBGXOffset<0>(Common::GetBitRange<15, 0>(value));
-                    ppu.SetBGYOffset<0>(Common::GetBitRange<31, 16>(value));
-                    return;
-                case 0x4000014:
-                    ppu.SetBGXOffset<1>(Common::GetBitRange<15, 0>(value));
-                    ppu.SetBGYOffset<1>(Common::GetBitRange<31, 16>(value));
-                    return;
-                case 0x4000018:
-                    ppu.SetBGXOffset<2>(Common::GetBitRange<15, 0>(value));
-                    ppu.SetBGYOffset<2>(Common::GetBitRange<31, 16>(value));
-                    return;
-                case 0x400001C:
-                    ppu.SetBGXOffset<3>(Common::GetBitRange<15, 0>(value));
-                    ppu.SetBGYOffset<3>(Common::GetBitRange<31, 16>(value));
-                    return;
-                case 0x40000B0:
-                    dma_channels[0].source_address = value;
-                    return;
-                case 0x40000B4:
-                    dma_channels[0].destination_address = value;
-                    return;
-                case 0x40000B8:
-                    dma_channels[0].word_count = Common::GetBitRange<15, 0>(value);
-                    SetDMAControl<0>(Common::GetBitRange<31, 16>(value));
-                    return;
-                case 0x40000BC:
-                    dma_channels[1].source_address = value;
-                    return;
-                case 0x40000C0:
-                    dma_channels[1].destination_address = value;
-                    return;
-                case 0x40000C4:
-                    dma_channels[1].word_count = Common::GetBitRange<15, 0>(value);
-                    SetDMAControl<1>(Common::GetBitRange<31, 16>(value));
-                    return;
-                case 0x40000C8:
-                    dma_channels[2].source_address = value;
-                    return;
-                case 0x40000CC:
-                    dma_channels[2].destination_address = value;
-                    return;
-                case 0x40000D0:
-                    dma_channels[2].word_count = Common::GetBitRange<15, 0>(value);
-                    SetDMAControl<2>(Common::GetBitRange<31, 16>(value));
-                    return;
-                case 0x40000D4:
-                    dma_channels[3].source_address = value;
-                    return;
-                case 0x40000D8:
-                    dma_channels[3].destination_address = value;
-                    return;
-                case 0x40000DC:
-                    dma_channels[3].word_count = Common::GetBitRange<15, 0>(value);
-                    SetDMAControl<3>(Common::GetBitRange<31, 16>(value));
-                    return;
-                case 0x4000100:
-                    timers.timer0.SetReload(Common::GetBitRange<15, 0>(value));
-                    timers.timer0.SetControl(Common::GetBitRange<31, 16>(value));
-                    return;
-                case 0x4000104:
-                    timers.timer1.SetReload(Common::GetBitRange<15, 0>(value));
-                    timers.timer1.SetControl(Common::GetBitRange<31, 16>(value));
-                    return;
-                case 0x4000108:
-                    timers.timer2.SetReload(Common::GetBitRange<15, 0>(value));
-                    timers.timer2.SetControl(Common::GetBitRange<31, 16>(value));
-                    return;
-                case 0x400010C:
-                    timers.timer2.SetReload(Common::GetBitRange<15, 0>(value));
-                    timers.timer2.SetControl(Common::GetBitRange<31, 16>(value));
-                    return;
-                case 0x4000200:
-                    interrupts.SetIE(Common::GetBitRange<15, 0>(value));
-                    interrupts.SetIF(Common::GetBitRange<31, 16>(value));
-                    return;
-                case 0x4000204:
-                    timers.SetWaitstateControl(Common::GetBitRange<15, 0>(value));
-                    return;
-                case 0x4000208:
-                    interrupts.SetIME(Common::IsBitSet<0>(value));
-                    return;
-                default:
-                    LERROR("unrecognized write32 0x{:08X} to IO register 0x{:08X}", value, masked_addr);
-                    return;
-            }
+// Registers that only hold whatever was written to them.
+static constexpr void WritePlainIORegister(Bus&, u16, u16) {}
+
+template <u8 bg_no>
+consteval void Bus::AddBGRegisters(IORegisterTable& table) {
+    table[(0x008 >> 1) + bg_no] = {
+        [](Bus& bus, u16) -> u16 { return bus.ppu.GetBGCNT<bg_no>(); },
+        [](Bus& bus, u16 value, u16) { bus.ppu.SetBGCNT<bg_no>(value); },
+    };
+    table[(0x010 >> 1) + bg_no * 2] = {
+        ReadWriteOnlyIORegister,
+        [](Bus& bus, u16 value, u16) { bus.ppu.SetBGXOffset<bg_no>(value); },
+    };
+    table[(0x012 >> 1) + bg_no * 2] = {
+        ReadWriteOnlyIORegister,
+        [](Bus& bus, u16 value, u16) { bus.ppu.SetBGYOffset<bg_no>(value); },
+    };
+}
 
-        case 0x5:
-            LDEBUG("write32 0x{:08X} to 0x{:08X} (PRAM)", value, masked_addr);
-            ppu.WritePRAM<u32>(masked_addr & 0x3FF, value);
-            return;
+template <u8 window_no>
+consteval void Bus::AddWindowRegisters(IORegisterTable& table) {
+    table[(0x040 >> 1) + window_no] = {
+        ReadWriteOnlyIORegister,
+        [](Bus& bus, u16 value, u16) { bus.ppu.SetWINH<window_no>(value); },
+    };
+    table[(0x044 >> 1) + window_no] = {
+        ReadWriteOnlyIORegister,
+        [](Bus& bus, u16 value, u16) { bus.ppu.SetWINV<window_no>(value); },
+    };
+}
 
-        case 0x6: {
-            u32 address = masked_addr & 0x1FFFF;
-            if (address > 0x17FFF) {
-                address -= 0x8000;
-            }
+template <u8 dma_channel_no>
+consteval void Bus::AddDMARegisters(IORegisterTable& table) {
+    constexpr std::size_t index = (0x0B0 + dma_channel_no * 0xC) >> 1;
+
+    // The address registers are split in two halves, so they're put back together from the
+    // stored values every time either half is written.
+    table[index] = table[index + 1] = {
+        ReadWriteOnlyIORegister,
+        [](Bus& bus, u16, u16) {
+            bus.dma_channels[dma_channel_no].source_address = bus.io_registers[index] | (bus.io_registers[index + 1] << 16);
+        },
+    };
+    table[index + 2] = table[index + 3] = {
+        ReadWriteOnlyIORegister,
+        [](Bus& bus, u16, u16) {
+            bus.dma_channels[dma_channel_no].destination_address = bus.io_registers[index + 2] | (bus.io_registers[index + 3] << 16);
+        },
+    };
+    table[index + 4] = {
+        ReadWriteOnlyIORegister,
+        [](Bus& bus, u16 value, u16) { bus.dma_channels[dma_channel_no].word_count = value; },
+    };
+    // Merged against the live control value rather than the stored one, since channels clear
+    // their enable bit by themselves when they finish.
+    table[index + 5] = {
+        [](Bus& bus, u16) -> u16 { return bus.dma_channels[dma_channel_no].control.raw; },
+        [](Bus& bus, u16 value, u16 mask) {
+            const u16 control = bus.dma_channels[dma_channel_no].control.raw;
+            bus.SetDMAControl<dma_channel_no>((control & ~mask) | (value & mask));
+        },
+    };
+}
 
-            LDEBUG("write32 0x{:08X} to 0x{:08X} (VRAM)", value, masked_addr);
-            ppu.WriteVRAM<u32>(address, value);
-            return;
-        }
+template <u8 timer_no>
+consteval void Bus::AddTimerRegisters(IORegisterTable& table) {
+    constexpr std::size_t index = (0x100 + timer_no * 4) >> 1;
+
+    table[index] = {
+        [](Bus& bus, u16) -> u16 {
+            bus.volatile_read_count++;
+            return bus.GetTimer<timer_no>().GetCounter();
+        },
+        [](Bus& bus, u16 value, u16) { bus.GetTimer<timer_no>().SetReload(value); },
+    };
+    table[index + 1] = {
+        [](Bus& bus, u16) -> u16 { return bus.GetTimer<timer_no>().GetControl(); },
+        [](Bus& bus, u16 value, u16) { bus.GetTimer<timer_no>().SetControl(value); },
+    };
+}
 
-        case 0x7:
-            ppu.WriteOAM<u32>(masked_addr & 0x3FF, value);
-            return;
+consteval Bus::IORegisterTable Bus::GenerateIORegisterTable() {
+    IORegisterTable table {};
+
+    table[0x000 >> 1] = {
+        [](Bus& bus, u16) -> u16 { return bus.ppu.GetDISPCNT(); },
+        [](Bus& bus, u16 value, u16) { bus.ppu.SetDISPCNT(value); },
+    };
+    // TODO: green swap
+    table[0x002 >> 1] = {nullptr, WritePlainIORegister};
+    table[0x004 >> 1] = {
+        [](Bus& bus, u16) -> u16 { return bus.ppu.GetDISPSTAT(); },
+        [](Bus& bus, u16 value, u16) { bus.ppu.SetDISPSTAT(value); },
+    };
+    table[0x006 >> 1] = {
+        [](Bus& bus, u16) -> u16 { return bus.ppu.GetVCOUNT(); },
+        nullptr,
+    };
+
+    AddBGRegisters<0>(table);
+    AddBGRegisters<1>(table);
+    AddBGRegisters<2>(table);
+    AddBGRegisters<3>(table);
+
+    AddWindowRegisters<0>(table);
+    AddWindowRegisters<1>(table);
+    table[0x048 >> 1] = {
+        [](Bus& bus, u16) -> u16 { return bus.ppu.GetWININ(); },
+        [](Bus& bus, u16 value, u16) { bus.ppu.SetWININ(value); },
+    };
+    table[0x04A >> 1] = {
+        [](Bus& bus, u16) -> u16 { return bus.ppu.GetWINOUT(); },
+        [](Bus& bus, u16 value, u16) { bus.ppu.SetWINOUT(value); },
+    };
+
+    table[0x050 >> 1] = {
+        [](Bus& bus, u16) -> u16 { return bus.ppu.GetBLDCNT(); },
+        [](Bus& bus, u16 value, u16) { bus.ppu.SetBLDCNT(value); },
+    };
+    table[0x052 >> 1] = {
+        [](Bus& bus, u16) -> u16 { return bus.ppu.GetBLDALPHA(); },
+        [](Bus& bus, u16 value, u16) { bus.ppu.SetBLDALPHA(value); },
+    };
+    table[0x054 >> 1] = {
+        ReadWriteOnlyIORegister,
+        [](Bus& bus, u16 value, u16) { bus.ppu.SetBLDY(value); },
+    };
+    table[0x056 >> 1] = {nullptr, WritePlainIORegister};
+
+    AddDMARegisters<0>(table);
+    AddDMARegisters<1>(table);
+    AddDMARegisters<2>(table);
+    AddDMARegisters<3>(table);
+
+    AddTimerRegisters<0>(table);
+    AddTimerRegisters<1>(table);
+    AddTimerRegisters<2>(table);
+    AddTimerRegisters<3>(table);
+
+    table[0x130 >> 1] = {
+        [](Bus& bus, u16) -> u16 { return bus.keypad.GetState(); },
+        nullptr,
+    };
+    // TODO: keypad interrupts
+    table[0x132 >> 1] = {nullptr, WritePlainIORegister};
+
+    table[0x200 >> 1] = {
+        [](Bus& bus, u16) -> u16 { return bus.interrupts.GetIE(); },
+        [](Bus& bus, u16 value, u16) { bus.interrupts.SetIE(value); },
+    };
+    // Only the bits that were written acknowledge interrupts, the stored value doesn't matter.
+    table[0x202 >> 1] = {
+        [](Bus& bus, u16) -> u16 { return bus.interrupts.GetIF(); },
+        [](Bus& bus, u16 value, u16 mask) { bus.interrupts.SetIF(value & mask); },
+    };
+    table[0x204 >> 1] = {
+        [](Bus& bus, u16) -> u16 { return bus.timers.GetWaitstateControl(); },
+        [](Bus& bus, u16 value, u16) { bus.timers.SetWaitstateControl(value); },
+    };
+    table[0x206 >> 1] = {nullptr, WritePlainIORegister};
+    table[0x208 >> 1] = {
+        [](Bus& bus, u16) -> u16 { return bus.interrupts.GetIME(); },
+        [](Bus& bus, u16 value, u16) { bus.interrupts.SetIME(Common::IsBitSet<0>(value)); },
+    };
+    table[0x20A >> 1] = {nullptr, WritePlainIORegister};
+
+    // POSTFLG is the low byte, HALTCNT the (write-only) high byte.
+    table[0x300 >> 1] = {
+        [](Bus& bus, u16) -> u16 { return bus.post_flg; },
+        [](Bus& bus, u16 value, u16 mask) {
+            if (Common::IsBitSet<0>(mask)) {
+                bus.post_flg = Common::IsBitSet<0>(value);
+            }
 
-        case 0x8:
-            // LWARN("tried to write32 0x{:08X} to 0x{:08X} (cartridge space)", value, masked_addr);
-            return;
+            if (Common::IsBitSet<8>(mask)) {
+                if (!Common::IsBitSet<15>(value)) {
+                    bus.arm7.halted = true;
+                } else {
+                    // TODO: stop mode
+                }
+            }
+        },
+    };
+    table[0x302 >> 1] = {nullptr, WritePlainIORegister};
 
-        default:
-            LERROR("unrecognized write32 0x{:08X} to 0x{:08X}", value, addr);
-    }
+    return table;
 }
 
+constexpr Bus::IORegisterTable Bus::io_register_table = GenerateIORegisterTable();
+
 template <u8 dma_channel_no>
 void Bus::SetDMAControl(const u16 value) {
     static_assert(dma_channel_no < 4);
     DMAChannel& channel = dma_channels[dma_channel_no];
 
+    const bool was_enabled = channel.control.flags.enable;
     channel.control.raw = value;
 
     // Bits 4-0 are unused.
@@ -705,8 +517,77 @@ void Bus::SetDMAControl(const u16 value) {
         channel.control.flags.gamepak_dma3_drq = false;
     }
 
-    if (channel.control.flags.enable) {
-        RunDMATransfer<dma_channel_no>();
+    if (!was_enabled && channel.control.flags.enable) {
+        // The internal registers are only latched when the channel gets enabled, so they keep
+        // counting from where they left off across repeated transfers.
+        channel.internal_source_address = channel.source_address;
+        channel.internal_destination_address = channel.destination_address;
+        channel.internal_word_count = GetDMAWordCount<dma_channel_no>();
+
+        const auto start_timing = static_cast<DMAStartTiming>(channel.control.flags.start_timing);
+        if (start_timing == DMAStartTiming::Immediately) {
+            ScheduleDMATransfer(dma_channel_no);
+        } else if (start_timing == DMAStartTiming::Special) {
+            LWARN("DMA{} was armed for its special start timing, which isn't implemented", dma_channel_no);
+        }
+    }
+}
+
+template <u8 dma_channel_no>
+u32 Bus::GetDMAWordCount() const {
+    // DMA0-2 only use the low 14 bits of the word count, and a count of 0 means the largest
+    // possible transfer.
+    constexpr u16 word_count_mask = dma_channel_no == 3 ? 0xFFFF : 0x3FFF;
+    const u16 word_count = dma_channels[dma_channel_no].word_count & word_count_mask;
+    if (word_count != 0) {
+        return word_count;
+    }
+
+    return dma_channel_no == 3 ? 0x10000 : 0x4000;
+}
+
+void Bus::ScheduleDMATransfer(const u8 dma_channel_no) {
+    // Transfers start 2 cycles after being triggered.
+    constexpr std::array start_events = {
+        Scheduler::EventType::DMA0Start,
+        Scheduler::EventType::DMA1Start,
+        Scheduler::EventType::DMA2Start,
+        Scheduler::EventType::DMA3Start,
+    };
+    scheduler.Schedule(start_events[dma_channel_no], 2);
+    arm7.StopForNewEvent();
+}
+
+void Bus::TriggerDMATransfers(const DMAStartTiming start_timing) {
+    for (u8 dma_channel_no = 0; dma_channel_no < dma_channels.size(); dma_channel_no++) {
+        const DMACNT& control = dma_channels[dma_channel_no].control;
+        if (control.flags.enable && static_cast<DMAStartTiming>(control.flags.start_timing) == start_timing) {
+            ScheduleDMATransfer(dma_channel_no);
+        }
+    }
+}
+
+void Bus::StartDMATransfer(const u8 dma_channel_no) {
+    // The channel may have been disabled again before the transfer started.
+    if (!dma_channels[dma_channel_no].control.flags.enable) {
+        return;
+    }
+
+    switch (dma_channel_no) {
+        case 0:
+            RunDMATransfer<0>();
+            break;
+        case 1:
+            RunDMATransfer<1>();
+            break;
+        case 2:
+            RunDMATransfer<2>();
+            break;
+        case 3:
+            RunDMATransfer<3>();
+            break;
+        default:
+            UNREACHABLE();
     }
 }
 
@@ -715,11 +596,11 @@ void Bus::RunDMATransfer() {
     DMAChannel& channel = dma_channels[dma_channel_no];
 
     const bool transfer_32bit = channel.control.flags.transfer_type_is_32bit;
-    LINFO("Running {}bit DMA{} transfer (source={:08X}, destination={:08X}, words={})", transfer_32bit ? 32 : 16,
+    LDEBUG("Running {}bit DMA{} transfer (source={:08X}, destination={:08X}, words={})", transfer_32bit ? 32 : 16,
                                                                                         dma_channel_no,
-                                                                                        channel.source_address,
-                                                                                        channel.destination_address,
-                                                                                        channel.word_count);
+                                                                                        channel.internal_source_address,
+                                                                                        channel.internal_destination_address,
+                                                                                        channel.internal_word_count);
 
     s8 destination_offset = 0;
     s8 source_offset = 0;
@@ -759,25 +640,15 @@ void Bus::RunDMATransfer() {
             UNREACHABLE();
     }
 
-    u32 destination_address = channel.destination_address;
-    u32 source_address = channel.source_address;
-
     if (transfer_32bit) {
-        for (std::size_t i = 0; i < channel.word_count; i++) {
-            Write32(destination_address, Read32(source_address));
-
-            destination_address += destination_offset * sizeof(u32);
-            source_address += source_offset * sizeof(u32);
-        }
+        TransferDMAUnits<u32>(channel.internal_destination_address, channel.internal_source_address, destination_offset, source_offset, channel.internal_word_count);
     } else {
-        for (std::size_t i = 0; i < channel.word_count; i++) {
-            Write16(destination_address, Read16(source_address));
-
-            destination_address += destination_offset * sizeof(u16);
-            source_address += source_offset * sizeof(u16);
-        }
+        TransferDMAUnits<u16>(channel.internal_destination_address, channel.internal_source_address, destination_offset, source_offset, channel.internal_word_count);
     }
 
+    // The CPU is stopped for 2 internal cycles, then a read and a write per unit.
+    scheduler.AddCycles(2 + 2 * channel.internal_word_count);
+
     if (channel.control.flags.irq_at_end_of_word_count) {
         switch (dma_channel_no) {
             case 0:
@@ -797,7 +668,88 @@ void Bus::RunDMATransfer() {
         }
     }
 
-    if (!channel.control.flags.repeat) {
+    // Repeating VBlank and HBlank transfers stay armed until their next trigger.
+    const auto start_timing = static_cast<DMAStartTiming>(channel.control.flags.start_timing);
+    if (!channel.control.flags.repeat || start_timing == DMAStartTiming::Immediately) {
         channel.control.flags.enable = false;
+        return;
+    }
+
+    channel.internal_word_count = GetDMAWordCount<dma_channel_no>();
+    if (channel.control.flags.dest_addr_control == 3) {
+        channel.internal_destination_address = channel.destination_address;
+    }
+}
+
+template <UnsignedIntegerMax32 T>
+void Bus::TransferDMAUnits(u32& destination_address, u32& source_address, const s32 destination_step, const s32 source_step, u32 count) {
+    // DMA addresses are forced to be aligned.
+    destination_address &= ~static_cast<u32>(sizeof(T) - 1);
+    source_address &= ~static_cast<u32>(sizeof(T) - 1);
+
+    // How many units from addr onward, moving by step, stay inside region.
+    const auto units_left_in = [count](const auto& region, const u32 addr, const s32 step) -> u32 {
+        if (step == 0) {
+            return count;
+        }
+
+        const u32 offset = addr - region.start;
+        const u32 units = step > 0 ? (region.size - offset) / sizeof(T) : offset / sizeof(T) + 1;
+        return std::min(units, count);
+    };
+
+    while (count != 0) {
+        const HostRegion<u8*> destination = GetHostRegion(write_pages, destination_address);
+        const HostRegion<const u8*> source = GetHostRegion(read_pages, source_address);
+
+        // IO, ROM writes and anything else that isn't plain memory go through the bus one unit at a time.
+        if (destination.size == 0 || source.size == 0) {
+            if constexpr (std::is_same_v<T, u32>) {
+                Write32(destination_address, Read32(source_address));
+            } else {
+                Write16(destination_address, Read16(source_address));
+            }
+
+            destination_address += destination_step * sizeof(T);
+            source_address += source_step * sizeof(T);
+            count--;
+            continue;
+        }
+
+        const u32 units = std::min(units_left_in(destination, destination_address, destination_step),
+                                   units_left_in(source, source_address, source_step));
+        u8* destination_pointer = destination.pointer + (destination_address - destination.start);
+        const u8* source_pointer = source.pointer + (source_address - source.start);
+        const std::size_t bytes = units * sizeof(T);
+
+        // A forward copy only matches memmove() if it never reads something it already wrote.
+        if (destination_step == 1 && source_step == 1 &&
+            (destination_pointer <= source_pointer || destination_pointer >= source_pointer + bytes)) {
+            std::memmove(destination_pointer, source_pointer, bytes);
+        } else {
+            for (u32 i = 0; i < units; i++) {
+                std::memcpy(destination_pointer + destination_step * static_cast<s32>(i * sizeof(T)),
+                            source_pointer + source_step * static_cast<s32>(i * sizeof(T)), sizeof(T));
+            }
+        }
+
+        write_count += units;
+
+        // Code in WRAM that was overwritten has to be recompiled.
+        const u8 destination_region = (destination_address >> 24) & 0xF;
+        if (destination_region == 0x2 || destination_region == 0x3) {
+            const u32 first = destination_step < 0 ? destination_address - (bytes - sizeof(T)) : destination_address;
+            const u32 last = destination_step > 0 ? destination_address + (bytes - sizeof(T)) : destination_address;
+            arm7.InvalidateBlocks(first, last);
+        } else if (destination_region == 0x6) {
+            // So do tiles the PPU already decoded.
+            const u8* first = destination_step < 0 ? destination_pointer - (bytes - sizeof(T)) : destination_pointer;
+            const u8* last = destination_step > 0 ? destination_pointer + (bytes - sizeof(T)) : destination_pointer;
+            ppu.InvalidateTiles(first - ppu.vram.GetData(), last - ppu.vram.GetData() + sizeof(T) - 1);
+        }
+
+        destination_address += destination_step * static_cast<s32>(bytes);
+        source_address += source_step * static_cast<s32>(bytes);
+        count -= units;
     }
 }
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <array>
+#include <cstring>
+#include "common/defines.h"
+#include "common/memory_region.h"
 #include "common/types.h"
 #include "bios.h"
 #include "cartridge.h"
@@ -9,26 +12,59 @@
 #include "ppu.h"
 
 class ARM7;
+class Scheduler;
+class Timer;
 class Timers;
 
 class Bus {
 public:
-    Bus(BIOS& bios_, Cartridge& cartridge_, Keypad& keypad_, PPU& ppu_, Interrupts& interrupts_, ARM7& arm7_, Timers& timers_);
+    Bus(BIOS& bios_, Cartridge& cartridge_, Keypad& keypad_, PPU& ppu_, Interrupts& interrupts_, ARM7& arm7_, Timers& timers_, Scheduler& scheduler_);
 
-    [[nodiscard]] u8 Read8(u32 addr);
+    [[nodiscard]] ALWAYS_INLINE u8 Read8(const u32 addr) { return Read<u8>(addr); }
     void Write8(u32 addr, u8 value);
-    [[nodiscard]] u16 Read16(u32 addr);
+    [[nodiscard]] ALWAYS_INLINE u16 Read16(const u32 addr) { return Read<u16>(addr); }
     void Write16(u32 addr, u16 value);
-    [[nodiscard]] u32 Read32(u32 addr);
+    [[nodiscard]] ALWAYS_INLINE u32 Read32(const u32 addr) { return Read<u32>(addr); }
     void Write32(u32 addr, u32 value);
 
+    // A block of the address space that is accessed straight in host memory: the host address
+    // of `start + offset` is `pointer + offset` for any offset below `size`.
+    template <typename Pointer = const u8*>
+    struct HostRegion {
+        u32 start = 0;
+        u32 size = 0;
+        Pointer pointer = nullptr;
+    };
+
+    // Returns the largest such region containing addr, or an empty one if reads from addr have
+    // to go through Read*. Used by the ARM7 to fetch opcodes without going through the page table.
+    [[nodiscard]] HostRegion<> GetHostRegion(u32 addr) const;
+
+    // Used by the ARM7 to tell whether a loop has any side effects.
+    [[nodiscard]] u64 GetWriteCount() const { return write_count; }
+    // Reads of registers that change without a scheduled event (the timer counters), which a
+    // loop can be waiting on without any of its registers changing.
+    [[nodiscard]] u64 GetVolatileReadCount() const { return volatile_read_count; }
+
     [[nodiscard]] Keypad& GetKeypad() { return keypad; }
     [[nodiscard]] const Keypad& GetKeypad() const { return keypad; }
 
+    enum class DMAStartTiming : u8 {
+        Immediately = 0,
+        VBlank = 1,
+        HBlank = 2,
+        Special = 3,
+    };
+
+    // Called by the PPU to start the channels that are waiting for VBlank or HBlank.
+    void TriggerDMATransfers(DMAStartTiming start_timing);
+
     [[nodiscard]] Interrupts& GetInterrupts() { return interrupts; }
     [[nodiscard]] const Interrupts& GetInterrupts() const { return interrupts; }
     
 private:
+    friend class Scheduler;
+
     BIOS& bios;
     Cartridge& cartridge;
     Keypad& keypad;
@@ -36,9 +72,104 @@ private:
     Interrupts& interrupts;
     ARM7& arm7;
     Timers& timers;
+    Scheduler& scheduler;
+
+    u64 write_count = 0;
+    u64 volatile_read_count = 0;
+
+    // The address space is split into 16 KB pages. Pages backed by plain memory point straight
+    // at it, so accessing them is a table lookup plus a native load or store. Pages without a
+    // pointer (IO and unused regions) go through the Slow* handlers.
+    static constexpr u32 PAGE_BITS = 14;
+    static constexpr u32 PAGE_SIZE = 1 << PAGE_BITS;
+    static constexpr std::size_t PAGE_COUNT = 0x10000000 >> PAGE_BITS;
+
+    template <typename Pointer>
+    struct Page {
+        Pointer pointer = nullptr;
+        // Applied to the address before indexing `pointer`, which mirrors regions smaller than a page.
+        u32 mask = 0;
+    };
+
+    std::array<Page<const u8*>, PAGE_COUNT> read_pages {};
+    std::array<Page<u8*>, PAGE_COUNT> write_pages {};
+
+    [[nodiscard]] static constexpr std::size_t GetPageIndex(const u32 addr) {
+        return (addr & 0x0FFFFFFF) >> PAGE_BITS;
+    }
+
+    void MapPages();
+
+    template <typename Pointer>
+    [[nodiscard]] static HostRegion<Pointer> GetHostRegion(const std::array<Page<Pointer>, PAGE_COUNT>& pages, u32 addr);
+
+    template <UnsignedIntegerMax32 T>
+    [[nodiscard]] ALWAYS_INLINE T Read(const u32 addr) {
+        const u32 aligned_addr = addr & ~static_cast<u32>(sizeof(T) - 1);
+        const Page<const u8*>& page = read_pages[GetPageIndex(aligned_addr)];
+        if (page.pointer) [[likely]] {
+            T value;
+            std::memcpy(&value, page.pointer + (aligned_addr & page.mask), sizeof(T));
+            return value;
+        }
+
+        if constexpr (std::is_same_v<T, u8>) {
+            return SlowRead8(addr);
+        } else if constexpr (std::is_same_v<T, u16>) {
+            return SlowRead16(addr);
+        } else {
+            return SlowRead32(addr);
+        }
+    }
 
-    std::array<u8, 0x40000> wram_onboard {};
-    std::array<u8, 0x8000> wram_onchip {};
+    // Returns false if the page isn't mapped, in which case the caller has to handle the write.
+    template <UnsignedIntegerMax32 T>
+    bool WriteToPage(u32 addr, T value);
+
+    [[nodiscard]] u8 SlowRead8(u32 addr);
+    [[nodiscard]] u16 SlowRead16(u32 addr);
+    [[nodiscard]] u32 SlowRead32(u32 addr);
+
+    // IO registers are looked up by their offset in a table of halfword registers. 8-bit and
+    // 32-bit accesses are split into (or put together from) halfword accesses.
+    static constexpr std::size_t IO_REGISTER_COUNT = 0x400 / 2;
+
+    struct IORegister {
+        // Gets the last value written to the register. Registers without a read handler read as
+        // that value, unless they're also missing a write handler, in which case they're unmapped.
+        u16 (*read)(Bus& bus, u16 stored_value) = nullptr;
+        // Gets the register's new value and which of its bits were written.
+        // Registers without a write handler are read-only.
+        void (*write)(Bus& bus, u16 value, u16 mask) = nullptr;
+    };
+
+    using IORegisterTable = std::array<IORegister, IO_REGISTER_COUNT>;
+
+    static consteval IORegisterTable GenerateIORegisterTable();
+    template <u8 bg_no>
+    static consteval void AddBGRegisters(IORegisterTable& table);
+    template <u8 window_no>
+    static consteval void AddWindowRegisters(IORegisterTable& table);
+    template <u8 dma_channel_no>
+    static consteval void AddDMARegisters(IORegisterTable& table);
+    template <u8 timer_no>
+    static consteval void AddTimerRegisters(IORegisterTable& table);
+    static const IORegisterTable io_register_table;
+
+    std::array<u16, IO_REGISTER_COUNT> io_registers {};
+
+    template <UnsignedIntegerMax32 T>
+    [[nodiscard]] T ReadIO(u32 addr);
+    template <UnsignedIntegerMax32 T>
+    void WriteIO(u32 addr, T value);
+    [[nodiscard]] u16 ReadIORegister(std::size_t index);
+    void WriteIORegister(std::size_t index, u16 value, u16 mask);
+
+    template <u8 timer_no>
+    [[nodiscard]] Timer& GetTimer();
+
+    MemoryRegion<0x40000> wram_onboard;
+    MemoryRegion<0x8000> wram_onchip;
 
     union DMACNT {
         u16 raw;
@@ -60,6 +191,12 @@ private:
         u32 destination_address;
         u16 word_count;
         DMACNT control;
+
+        // What the channel is actually working with, latched from the registers above when it
+        // gets enabled. The addresses keep going from where the last transfer left them.
+        u32 internal_source_address;
+        u32 internal_destination_address;
+        u32 internal_word_count;
     };
 
     std::array<DMAChannel, 4> dma_channels {};
@@ -67,8 +204,20 @@ private:
     template <u8 dma_channel_no>
     void SetDMAControl(u16 value);
 
+    template <u8 dma_channel_no>
+    [[nodiscard]] u32 GetDMAWordCount() const;
+
+    void ScheduleDMATransfer(u8 dma_channel_no);
+
     template <u8 dma_channel_no>
     void RunDMATransfer();
 
+    // Copies `count` units, going through host memory directly wherever both sides allow it.
+    // Leaves the addresses pointing past the last unit.
+    template <UnsignedIntegerMax32 T>
+    void TransferDMAUnits(u32& destination_address, u32& source_address, s32 destination_step, s32 source_step, u32 count);
+
+    void StartDMATransfer(u8 dma_channel_no);
+
     bool post_flg = false;
 };
@@ -1,34 +1,126 @@
 #include <algorithm>
-#include <fstream>
+#include <array>
+#include <bit>
+#include <string_view>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "cartridge.h"
 #include "common/logging.h"
 
 constexpr int TITLE_OFFSET = 0xA0;
 constexpr int TITLE_LENGTH = 12;
+constexpr int GAME_CODE_OFFSET = 0xAC;
+constexpr int GAME_CODE_LENGTH = 4;
+
+struct KnownIdleLoop {
+    std::string_view game_code;
+    u32 address;
+};
+
+// Idle loops that the ARM7's detection doesn't catch on its own, keyed by game code,
+// e.g. { "ABCE", 0x08001234 }.
+constexpr std::array<KnownIdleLoop, 0> KNOWN_IDLE_LOOPS {};
 
 Cartridge::Cartridge(const std::filesystem::path& cartridge_path) {
     LINFO("loading cartridge: {}", cartridge_path.string());
     LoadCartridge(cartridge_path);
 }
 
+Cartridge::~Cartridge() {
+    if (rom) {
+        munmap(const_cast<u8*>(rom), window_size);
+    }
+}
+
 void Cartridge::LoadCartridge(const std::filesystem::path& cartridge_path) {
-    std::ifstream stream(cartridge_path.string().c_str(), std::ios::binary);
-    ASSERT_MSG(stream.is_open(), "could not open ROM: {}", cartridge_path.string());
+    const int fd = open(cartridge_path.c_str(), O_RDONLY);
+    ASSERT_MSG(fd != -1, "could not open ROM: {}", cartridge_path.string());
+
+    struct stat file_info {};
+    ASSERT_MSG(fstat(fd, &file_info) == 0, "could not get the size of ROM: {}", cartridge_path.string());
+    ASSERT_MSG(file_info.st_size > 0 && file_info.st_size <= MAX_ROM_SIZE, "ROM has to be between 1 byte and 32 MB: {}", cartridge_path.string());
+    rom_size = file_info.st_size;
+
+    // Never smaller than the open bus pattern, so the window always covers whole pages.
+    window_size = std::bit_ceil(std::max<u32>(rom_size, open_bus.GetSize()));
 
-    rom_size = std::filesystem::file_size(cartridge_path);
-    rom.resize(rom_size);
+    // Reserve the window and map the file read-only over the start of it, so that the ROM is
+    // shared with the page cache instead of being copied.
+    u8* window = static_cast<u8*>(mmap(nullptr, window_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    ASSERT_MSG(window != MAP_FAILED, "could not reserve {} bytes for the ROM", window_size);
 
-    stream.read(reinterpret_cast<char*>(rom.data()), rom.size());
+    int flags = MAP_PRIVATE | MAP_FIXED;
+#ifdef MAP_POPULATE
+    // Read the whole ROM in now instead of faulting it in while the game runs.
+    flags |= MAP_POPULATE;
+#endif
+    ASSERT_MSG(mmap(window, rom_size, PROT_READ, flags, fd, 0) != MAP_FAILED, "could not map ROM: {}", cartridge_path.string());
+    close(fd);
+
+#ifdef MADV_HUGEPAGE
+    madvise(window, window_size, MADV_HUGEPAGE);
+#endif
+
+    // The open bus values after the end of the ROM start in the file's last page if it is only
+    // partly used. Only that page is made writable, and the mapping is private, so filling it
+    // copies just that one page and never touches the file.
+    const u32 page_size = sysconf(_SC_PAGESIZE);
+    const u32 last_file_page = rom_size & ~(page_size - 1);
+    if (last_file_page != rom_size) {
+        ASSERT_MSG(mprotect(window + last_file_page, page_size, PROT_READ | PROT_WRITE) == 0, "could not make the end of the ROM writable");
+    }
+
+    FillWithOpenBusValues(window, rom_size, window_size);
+    FillWithOpenBusValues(open_bus.GetData(), 0, open_bus.GetSize());
+
+    ASSERT_MSG(mprotect(window, window_size, PROT_READ) == 0, "could not make the ROM read-only");
+    rom = window;
 
     LINFO("cartridge: loaded {} bytes ({} KB)", rom_size, rom_size / 1024);
 }
 
+void Cartridge::FillWithOpenBusValues(u8* data, const u32 start, const u32 end) {
+    for (u32 offset = start; offset < end; offset++) {
+        const u16 halfword = offset >> 1;
+        data[offset] = (offset & 1) ? (halfword >> 8) : (halfword & 0xFF);
+    }
+}
+
 std::string Cartridge::GetGameTitle() const {
+    if (rom_size < TITLE_OFFSET + TITLE_LENGTH) {
+        return {};
+    }
+
     std::string title;
 
-    const auto title_begin = rom.begin() + TITLE_OFFSET;
+    const u8* title_begin = rom + TITLE_OFFSET;
     const auto title_end = std::find(title_begin, title_begin + TITLE_LENGTH, '\0');
     std::copy(title_begin, title_end, std::back_inserter(title));
 
     return title;
 }
+
+std::string Cartridge::GetGameCode() const {
+    if (rom_size < GAME_CODE_OFFSET + GAME_CODE_LENGTH) {
+        return {};
+    }
+
+    const u8* game_code_begin = rom + GAME_CODE_OFFSET;
+    return std::string(game_code_begin, game_code_begin + GAME_CODE_LENGTH);
+}
+
+std::optional<u32> Cartridge::GetIdleLoopAddress() const {
+    const std::string game_code = GetGameCode();
+
+    const auto known_idle_loop = std::find_if(KNOWN_IDLE_LOOPS.begin(), KNOWN_IDLE_LOOPS.end(), [&](const KnownIdleLoop& idle_loop) {
+        return idle_loop.game_code == game_code;
+    });
+
+    if (known_idle_loop == KNOWN_IDLE_LOOPS.end()) {
+        return std::nullopt;
+    }
+
+    return known_idle_loop->address;
+}
@@ -1,39 +1,51 @@
 #pragma once
 
 #include <filesystem>
-#include <vector>
+#include <optional>
+#include <string>
+#include "common/memory_region.h"
 #include "common/types.h"
 
 class Cartridge {
 public:
     explicit Cartridge(const std::filesystem::path& cartridge_path);
+    ~Cartridge();
+
+    Cartridge(const Cartridge&) = delete;
+    Cartridge& operator=(const Cartridge&) = delete;
 
     [[nodiscard]] std::string GetGameTitle() const;
+    [[nodiscard]] std::string GetGameCode() const;
 
-    [[nodiscard]] std::size_t GetSize() const { return rom_size; }
+    // Returns the address of the game's main idle loop if it is one we know about.
+    [[nodiscard]] std::optional<u32> GetIdleLoopAddress() const;
 
-    template <UnsignedIntegerMax32 T>
-    [[nodiscard]] T Read(u32 addr) const {
-        if constexpr (std::is_same_v<T, u8>) {
-            return rom.at(addr);
-        }
+    [[nodiscard]] std::size_t GetSize() const { return rom_size; }
 
-        if constexpr (std::is_same_v<T, u16>) {
-            addr &= ~0b1;
-            return (rom.at(addr) |
-                   (rom.at(addr + 1) << 8));
+    // Returns where the byte at offset (from the start of the ROM's address space) lives in
+    // host memory. It stays valid for the rest of the 16 KB page offset is in.
+    [[nodiscard]] const u8* GetHostPointer(u32 offset) const {
+        offset &= MAX_ROM_SIZE - 1;
+        if (offset < window_size) {
+            return rom + offset;
         }
 
-        if constexpr (std::is_same_v<T, u32>) {
-            addr &= ~0b11;
-            return (rom.at(addr) |
-                   (rom.at(addr + 1) << 8) |
-                   (rom.at(addr + 2) << 16) |
-                   (rom.at(addr + 3) << 24));
-        }
+        return open_bus.GetData() + (offset & open_bus.GetMirrorMask());
     }
 private:
     void LoadCartridge(const std::filesystem::path& cartridge_path);
-    std::vector<u8> rom;
+
+    static constexpr u32 MAX_ROM_SIZE = 32 * 1024 * 1024;
+
+    // The ROM is mapped straight from the file, and the rest of the power-of-two sized window it
+    // is mapped into is filled with open bus values. Reads past the window use `open_bus` instead.
+    const u8* rom = nullptr;
     u32 rom_size = 0;
+    u32 window_size = 0;
+
+    // Reading past the end of the ROM returns the lower 16 bits of the halfword address,
+    // which repeat every 128 KB.
+    MemoryRegion<0x20000> open_bus;
+
+    static void FillWithOpenBusValues(u8* data, u32 start, u32 end);
 };
@@ -1,3 +1,16 @@
 #pragma once
 
 #define ALWAYS_INLINE __attribute__((always_inline)) inline
+
+// Builds the function once per listed x86-64 extension and picks the best version the CPU
+// supports when the program is loaded. Used on loops that are written for the compiler to vectorize.
+// It goes on the definition only, or every file that calls the function emits its own dispatcher.
+#if defined(__x86_64__) && defined(__has_attribute)
+#if __has_attribute(target_clones)
+#define TARGET_CLONES_SIMD __attribute__((target_clones("avx2", "sse4.1", "default")))
+#endif
+#endif
+
+#ifndef TARGET_CLONES_SIMD
+#define TARGET_CLONES_SIMD
+#endif
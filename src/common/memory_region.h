@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include "common/defines.h"
+#include "common/logging.h"
+#include "common/types.h"
+
+// What an 8-bit write does to a region.
+enum class ByteWriteBehavior {
+    Store,
+    // The byte is written to both halves of the halfword it's in (PRAM, VRAM).
+    Duplicate,
+    // The write is dropped (OAM).
+    Ignore,
+};
+
+// A fixed-size block of emulated memory.
+//
+// Addresses are ANDed with MirrorMask, so a region that is smaller than its slice of the address
+// space repeats throughout it, and then aligned to the size of the access. The data is kept in
+// host byte order, which (like the rest of the emulator) assumes a little-endian host.
+// Out of bounds accesses are only caught in builds without NDEBUG.
+template <std::size_t Size, u32 MirrorMask = Size - 1, ByteWriteBehavior byte_writes = ByteWriteBehavior::Store>
+class MemoryRegion {
+public:
+    static_assert((MirrorMask & (MirrorMask + 1)) == 0, "MirrorMask has to be a power of two minus one");
+
+    template <UnsignedIntegerMax32 T>
+    [[nodiscard]] ALWAYS_INLINE T Read(const u32 addr) const {
+        T value;
+        std::memcpy(&value, &data[GetOffset<T>(addr)], sizeof(T));
+        return value;
+    }
+
+    template <UnsignedIntegerMax32 T>
+    ALWAYS_INLINE void Write(const u32 addr, const T value) {
+        if constexpr (std::is_same_v<T, u8> && byte_writes == ByteWriteBehavior::Ignore) {
+            return;
+        } else if constexpr (std::is_same_v<T, u8> && byte_writes == ByteWriteBehavior::Duplicate) {
+            Write<u16>(addr, static_cast<u16>(value * 0x0101));
+        } else {
+            std::memcpy(&data[GetOffset<T>(addr)], &value, sizeof(T));
+        }
+    }
+
+    [[nodiscard]] u8* GetData() { return data.data(); }
+    [[nodiscard]] const u8* GetData() const { return data.data(); }
+
+    [[nodiscard]] static constexpr std::size_t GetSize() { return Size; }
+    [[nodiscard]] static constexpr u32 GetMirrorMask() { return MirrorMask; }
+
+private:
+    alignas(u32) std::array<u8, Size> data {};
+
+    template <UnsignedIntegerMax32 T>
+    [[nodiscard]] static ALWAYS_INLINE u32 GetOffset(const u32 addr) {
+        const u32 offset = addr & MirrorMask & ~static_cast<u32>(sizeof(T) - 1);
+#ifndef NDEBUG
+        ASSERT_MSG(offset + sizeof(T) <= Size, "out of bounds access at 0x{:X} in a 0x{:X} byte memory region", offset, Size);
+#endif
+        return offset;
+    }
+};
@@ -11,16 +11,16 @@ void DisplayFramebuffer([[maybe_unused]] std::array<u16, 240 * 160>& framebuffer
 
 }
 
-int main_null(char* argv[]) {
+int main_null(char* argv[], const CPUBackend cpu_backend) {
     const std::filesystem::path bios_path = argv[1];
     BIOS bios(bios_path);
     const std::filesystem::path cartridge_path = argv[2];
     Cartridge cartridge(cartridge_path);
 
-    GBA gba(bios, cartridge);
+    GBA gba(bios, cartridge, cpu_backend);
 
     while (true) {
-        gba.Run();
+        gba.RunFrame();
     }
 
     return 0;
@@ -1,10 +1,11 @@
 #pragma once
 
 #include <array>
+#include "gba.h"
 #include "keypad.h"
 #include "common/types.h"
 
-int main_null(char* argv[]);
+int main_null(char* argv[], CPUBackend cpu_backend);
 
 void HandleFrontendEvents([[maybe_unused]] Keypad* keypad);
 void DisplayFramebuffer([[maybe_unused]] std::array<u16, 240 * 160>& framebuffer);
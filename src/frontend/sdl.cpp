@@ -69,13 +69,13 @@ void Shutdown() {
     SDL_Quit();
 }
 
-int main_SDL(char* argv[]) {
+int main_SDL(char* argv[], const CPUBackend cpu_backend) {
     const std::filesystem::path bios_path = argv[1];
     const std::filesystem::path cartridge_path = argv[2];
     BIOS bios(bios_path);
     Cartridge cartridge(cartridge_path);
 
-    GBA gba(bios, cartridge);
+    GBA gba(bios, cartridge, cpu_backend);
 
     if (SDL_Init(SDL_INIT_EVERYTHING) < 0) {
         LFATAL("failed to initialize SDL: {}", SDL_GetError());
@@ -109,7 +109,7 @@ int main_SDL(char* argv[]) {
 
     running = true;
     while (running) {
-        gba.Run();
+        gba.RunFrame();
     }
 
     Shutdown();
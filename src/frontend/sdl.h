@@ -1,10 +1,11 @@
 #pragma once
 
 #include <array>
+#include "gba.h"
 #include "keypad.h"
 #include "common/types.h"
 
-int main_SDL(char* argv[]);
+int main_SDL(char* argv[], CPUBackend cpu_backend);
 
 void HandleFrontendEvents(Keypad* keypad);
 void DisplayFramebuffer(std::array<u16, 240 * 160>& framebuffer);
@@ -1,14 +1,68 @@
+#include <algorithm>
+#include <cstdlib>
+#include <optional>
 #include "gba.h"
 #include "common/logging.h"
 
-GBA::GBA(BIOS& bios, Cartridge& cartridge)
-    : ppu(bus, interrupts),
-      bus(bios, cartridge, keypad, ppu, interrupts, arm7, timers),
-      arm7(bus, timers),
-      timers(interrupts, ppu) {
+GBA::GBA(BIOS& bios, Cartridge& cartridge, const CPUBackend cpu_backend)
+    : scheduler(ppu, timers, bus),
+      ppu(bus, interrupts, scheduler),
+      bus(bios, cartridge, keypad, ppu, interrupts, arm7, timers, scheduler),
+      arm7(bus, scheduler),
+      timers(interrupts, scheduler) {
     LINFO("powering on...");
+
+    if (const std::optional<u32> idle_loop_address = cartridge.GetIdleLoopAddress()) {
+        LINFO("using known idle loop at 0x{:08X}", *idle_loop_address);
+        arm7.SetIdleLoopAddress(*idle_loop_address);
+    }
+
+    if (cpu_backend != CPUBackend::Interpreter) {
+        arm7.EnableJIT();
+    }
+
+    if (cpu_backend == CPUBackend::JITLockstep) {
+        LINFO("running in lockstep with the interpreter");
+        lockstep_reference = std::make_unique<GBA>(bios, cartridge);
+        lockstep_reference->ppu.DetachFrontend();
+    }
+}
+
+void GBA::RunUntil(const u64 timestamp) {
+    while (scheduler.GetCurrentTimestamp() < timestamp) {
+        RunTimeslice(timestamp);
+
+        if (lockstep_reference) {
+            lockstep_reference->keypad = keypad;
+            lockstep_reference->RunTimeslice(timestamp);
+            CheckLockstepReference();
+        }
+    }
+}
+
+void GBA::RunTimeslice(const u64 timestamp) {
+    // Only stop the CPU when something else needs to run.
+    arm7.RunUntil(std::min(timestamp, scheduler.GetNextEventTimestamp()));
+
+    scheduler.RunPendingEvents();
+}
+
+void GBA::CheckLockstepReference() {
+    const u64 reference_timestamp = lockstep_reference->scheduler.GetCurrentTimestamp();
+    if (arm7.MatchesState(lockstep_reference->arm7) && scheduler.GetCurrentTimestamp() == reference_timestamp) {
+        return;
+    }
+
+    LFATAL("the JIT diverged from the interpreter");
+    LFATAL("JIT, at timestamp {}:", scheduler.GetCurrentTimestamp());
+    arm7.DumpRegisters();
+    LFATAL("interpreter, at timestamp {}:", reference_timestamp);
+    lockstep_reference->arm7.DumpRegisters();
+    std::exit(1);
 }
 
-void GBA::Run() {
-    arm7.Step(false);
+void GBA::RunFrame() {
+    // 228 scanlines of 1232 cycles each
+    constexpr u64 CYCLES_PER_FRAME = 228 * 1232;
+    RunUntil(scheduler.GetCurrentTimestamp() + CYCLES_PER_FRAME);
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory>
 #include "arm7/arm7.h"
 #include "bios.h"
 #include "bus.h"
@@ -7,18 +8,34 @@
 #include "keypad.h"
 #include "interrupts.h"
 #include "ppu.h"
+#include "scheduler.h"
 #include "timer.h"
 
+enum class CPUBackend {
+    Interpreter,
+    JIT,
+    // Runs the JIT next to an interpreted copy of the system, and stops as soon as their CPUs disagree.
+    JITLockstep,
+};
+
 class GBA {
 public:
-    GBA(BIOS& bios, Cartridge& cartridge);
+    GBA(BIOS& bios, Cartridge& cartridge, CPUBackend cpu_backend = CPUBackend::Interpreter);
 
-    void Run();
+    // Runs the system until the scheduler's timestamp reaches the given timestamp.
+    void RunUntil(u64 timestamp);
+    void RunFrame();
 private:
+    Scheduler scheduler;
     PPU ppu;
     Bus bus;
     ARM7 arm7;
     Keypad keypad;
     Interrupts interrupts;
     Timers timers;
+
+    std::unique_ptr<GBA> lockstep_reference;
+
+    void RunTimeslice(u64 timestamp);
+    void CheckLockstepReference();
 };
@@ -4,6 +4,8 @@
 #include "common/logging.h"
 #include "common/types.h"
 
+class JIT;
+
 class Interrupts {
 public:
     Interrupts() = default;
@@ -29,26 +31,50 @@ public:
 
     ALWAYS_INLINE void SetIF(const u16 value) {
         interrupts_requested ^= value;
+        UpdateIRQLine();
     }
 
     [[nodiscard]] ALWAYS_INLINE u16 GetIE() const { return interrupts_enabled; }
 
     ALWAYS_INLINE void SetIE(const u16 value) {
         interrupts_enabled = value;
+        UpdateIRQLine();
     }
 
     [[nodiscard]] ALWAYS_INLINE bool GetIME() const { return interrupt_master_enable; }
 
     ALWAYS_INLINE void SetIME(const bool value) {
         interrupt_master_enable = value;
+        UpdateIRQLine();
     }
 
     ALWAYS_INLINE void RequestInterrupt(const Bits bit) {
         interrupts_requested |= static_cast<u16>(bit);
+        UpdateIRQLine();
+    }
+
+    // Called by the ARM7 whenever the CPSR's I bit changes.
+    ALWAYS_INLINE void SetCPUIRQsDisabled(const bool value) {
+        cpu_irqs_disabled = value;
+        UpdateIRQLine();
     }
 
+    // Set while the CPU has an IRQ to take: IME is on, an enabled interrupt was requested
+    // and the CPSR doesn't mask IRQs. Kept up to date on every change to those instead of
+    // being worked out before every instruction.
+    [[nodiscard]] ALWAYS_INLINE bool IsIRQLineAsserted() const { return irq_line; }
+
 private:
+    // Generated code checks the IRQ line directly.
+    friend class JIT;
+
     u16 interrupts_requested = 0;
     u16 interrupts_enabled = 0;
     bool interrupt_master_enable = false;
+    bool cpu_irqs_disabled = false;
+    bool irq_line = false;
+
+    ALWAYS_INLINE void UpdateIRQLine() {
+        irq_line = interrupt_master_enable && (interrupts_requested & interrupts_enabled) != 0 && !cpu_irqs_disabled;
+    }
 };
@@ -1,15 +1,29 @@
 #include <cstdio>
+#include <string_view>
 #include "frontend/frontend.h"
 
 int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        printf("usage: %s <bios> <cartridge>\n", argv[0]);
+    if (argc != 3 && argc != 4) {
+        printf("usage: %s <bios> <cartridge> [--jit | --jit-lockstep]\n", argv[0]);
         return 1;
     }
 
+    CPUBackend cpu_backend = CPUBackend::Interpreter;
+    if (argc == 4) {
+        const std::string_view option = argv[3];
+        if (option == "--jit") {
+            cpu_backend = CPUBackend::JIT;
+        } else if (option == "--jit-lockstep") {
+            cpu_backend = CPUBackend::JITLockstep;
+        } else {
+            printf("unknown option %s\n", argv[3]);
+            return 1;
+        }
+    }
+
 #ifdef HA_FRONTEND_SDL
-    return main_SDL(argv);
+    return main_SDL(argv, cpu_backend);
 #else
-    return main_null(argv);
+    return main_null(argv, cpu_backend);
 #endif
 }
@@ -1,57 +1,46 @@
+#include <algorithm>
+#include <cstring>
+#include <utility>
 #include "bus.h"
 #include "frontend/frontend.h"
 #include "common/logging.h"
 #include "ppu.h"
+#include "scheduler.h"
 
 constexpr u32 TILE_WIDTH = 8;
 constexpr u32 TILE_HEIGHT = 8;
 
-PPU::PPU(Bus& bus_, Interrupts& interrupts_)
-    : bus(bus_), interrupts(interrupts_) {
-    StartNewScanline();
-}
-
-void PPU::AdvanceCycles(u16 cycles) {
-    for (; cycles > 0; cycles--) {
-        vcycles++;
-        Tick();
-    }
-}
-
-void PPU::Tick() {
-    ASSERT(!scheduler_entries.empty());
+PPU::PPU(Bus& bus_, Interrupts& interrupts_, Scheduler& scheduler_)
+    : bus(bus_), interrupts(interrupts_), scheduler(scheduler_) {
+    dirty_tiles_4bpp.fill(true);
+    dirty_tiles_8bpp.fill(true);
 
-    const auto& next_entry = scheduler_entries.front();
-
-    // Check if it's time to run our scheduled function
-    if (next_entry.first == vcycles) {
-        // Run our scheduled function
-        next_entry.second();
-
-        // Remove our function from the queue
-        scheduler_entries.pop_front();
-    }
-}
-
-void PPU::ScheduleNewFunction(u64 cycles_from_now, const std::function<void()>& function) {
-    scheduler_entries.push_back(std::make_pair(vcycles + cycles_from_now, function));
+    StartNewScanline();
 }
 
 void PPU::StartNewScanline() {
-    ScheduleNewFunction(960, [this]() { StartHBlank(); });
+    scheduler.Schedule(Scheduler::EventType::HBlankStart, 960);
 }
 
 void PPU::StartHBlank() {
+    // Render the line before HBlank DMAs get a chance to change what the next one looks like.
+    RenderScanline();
+
     dispstat.flags.hblank = true;
     if (dispstat.flags.hblank_irq) {
         interrupts.RequestInterrupt(Interrupts::Bits::HBlank);
     }
-    ScheduleNewFunction(272, [this]() { EndHBlank(); });
+
+    // HBlank DMAs don't run during VBlank.
+    if (vcount < GBA_SCREEN_HEIGHT) {
+        bus.TriggerDMATransfers(Bus::DMAStartTiming::HBlank);
+    }
+
+    scheduler.Schedule(Scheduler::EventType::HBlankEnd, 272);
 }
 
 void PPU::EndHBlank() {
     dispstat.flags.hblank = false;
-    RenderScanline();
     vcount++;
 
     if (vcount == dispstat.flags.vcount_setting && dispstat.flags.vcounter_irq) {
@@ -68,12 +57,14 @@ void PPU::EndHBlank() {
         }
 
         dispstat.flags.vblank = true;
+        bus.TriggerDMATransfers(Bus::DMAStartTiming::VBlank);
         StartVBlankLine();
 
-        DisplayFramebuffer(framebuffer);
+        if (frontend_attached) {
+            DisplayFramebuffer(framebuffer);
+            HandleFrontendEvents(&bus.GetKeypad());
+        }
         framebuffer = {};
-
-        HandleFrontendEvents(&bus.GetKeypad());
     } else if (vcount > GBA_SCREEN_HEIGHT) {
         StartVBlankLine();
     } else {
@@ -90,49 +81,51 @@ void PPU::RenderScanline() {
         return;
     }
 
+    layer_line_count = 0;
+
     switch (dispcnt.flags.bg_mode) {
         case 0:
         case 1:
         case 2:
-            // Render the backdrop color before anything else.
-            for (std::size_t i = 0; i < GBA_SCREEN_WIDTH; i++) {
-                framebuffer.at(vcount * GBA_SCREEN_WIDTH + i) = ReadPRAM<u16>(0);
+            for (std::size_t bg_no = 0; bg_no < bgs.size(); bg_no++) {
+                if (IsBGScreenDisplayEnabled(bg_no)) {
+                    RenderTiledBGScanline(bg_no);
+                }
             }
 
-            RenderTiledBGScanlineByPriority(3);
-            RenderTiledSpriteScanlineByPriority(3);
-            RenderTiledBGScanlineByPriority(2);
-            RenderTiledSpriteScanlineByPriority(2);
-            RenderTiledBGScanlineByPriority(1);
-            RenderTiledSpriteScanlineByPriority(1);
-            RenderTiledBGScanlineByPriority(0);
-            RenderTiledSpriteScanlineByPriority(0);
-
+            RenderSpriteLayerScanline();
+            RenderWindowScanline();
+            CompositeScanline();
             break;
         case 3:
             for (std::size_t i = 0; i < GBA_SCREEN_WIDTH; i++) {
-                u16 color = ReadVRAM<u16>((vcount * GBA_SCREEN_WIDTH * sizeof(u16)) + i * sizeof(u16));
+                u16 color = vram.Read<u16>((vcount * GBA_SCREEN_WIDTH * sizeof(u16)) + i * sizeof(u16));
                 framebuffer.at(vcount * GBA_SCREEN_WIDTH + i) = color;
             }
 
             break;
         case 4:
-            for (std::size_t i = 0; i < GBA_SCREEN_WIDTH; i++) {
-                std::size_t vram_address = (vcount * GBA_SCREEN_WIDTH) + i;
-                if (dispcnt.flags.display_frame_select) {
-                    vram_address += 0xA000;
+            if (dispcnt.flags.screen_display2) {
+                LayerLine& line = AddLayerLine(Layer::BG2);
+                const LayerPixel attributes = GetLayerPixelAttributes(bgs[2].control.flags.bg_priority, Layer::BG2);
+                for (std::size_t i = 0; i < GBA_SCREEN_WIDTH; i++) {
+                    std::size_t vram_address = (vcount * GBA_SCREEN_WIDTH) + i;
+                    if (dispcnt.flags.display_frame_select) {
+                        vram_address += 0xA000;
+                    }
+
+                    // Color 0 is used for transparency.
+                    const u8 palette_index = vram.Read<u8>(vram_address);
+                    if (palette_index != 0) {
+                        const u16 color = pram.Read<u16>(palette_index * sizeof(u16));
+                        line[i] = attributes | color;
+                    }
                 }
-
-                const u16 palette_index = vram.at(vram_address) * sizeof(u16);
-                const u16 color = ReadPRAM<u16>(palette_index);
-                framebuffer.at((vcount * GBA_SCREEN_WIDTH) + i) = color;
             }
 
-            RenderTiledSpriteScanlineByPriority(3);
-            RenderTiledSpriteScanlineByPriority(2);
-            RenderTiledSpriteScanlineByPriority(1);
-            RenderTiledSpriteScanlineByPriority(0);
-
+            RenderSpriteLayerScanline();
+            RenderWindowScanline();
+            CompositeScanline();
             break;
         default:
             LERROR("PPU: unimplemented BG mode {}", dispcnt.flags.bg_mode);
@@ -140,6 +133,183 @@ void PPU::RenderScanline() {
     }
 }
 
+PPU::LayerPixel PPU::GetLayerPixelAttributes(const u8 priority, const Layer layer) const {
+    const u32 target_bit = GetLayerBit(layer);
+
+    LayerPixel attributes = (priority << 29) | (static_cast<u32>(layer) << 26);
+    if ((bldcnt.flags.first_targets >> target_bit) & 1) {
+        attributes |= FIRST_BLEND_TARGET;
+    }
+    if ((bldcnt.flags.second_targets >> target_bit) & 1) {
+        attributes |= SECOND_BLEND_TARGET;
+    }
+
+    return attributes;
+}
+
+PPU::LayerLine& PPU::AddLayerLine(const Layer layer) {
+    layer_line_window_bits[layer_line_count] = GetLayerBit(layer);
+    LayerLine& line = layer_lines[layer_line_count++];
+    line.fill(TRANSPARENT_PIXEL);
+    return line;
+}
+
+// Finds the two frontmost of the layer pixels in every column. Written without branches so it
+// can be vectorized, which is also why it takes plain pointers that can't alias each other.
+// Pixels of layers their window doesn't enable are turned transparent on the way.
+template <std::size_t layer_count>
+TARGET_CLONES_SIMD
+static void CompositeLayerPixels(const u32* __restrict layers, const u32* __restrict window_bits, const u32* __restrict window_pixels,
+                                 const u32 backdrop, u16* __restrict colors, u32* __restrict top_pixels, u32* __restrict second_pixels) {
+    for (std::size_t x = 0; x < GBA_SCREEN_WIDTH; x++) {
+        u32 first = backdrop;
+        u32 second = 0xFFFFFFFF;
+
+        // Unrolled so that it's the loop over the columns that gets vectorized.
+#pragma GCC unroll 8
+        for (std::size_t layer = 0; layer < layer_count; layer++) {
+            // All zeroes if the layer is enabled here, and all ones (transparent) if it isn't.
+            const u32 disabled = ((window_pixels[x] >> window_bits[layer]) & 1) - 1;
+            const u32 pixel = layers[layer * GBA_SCREEN_WIDTH + x] | disabled;
+            second = std::min(second, std::max(first, pixel));
+            first = std::min(first, pixel);
+        }
+
+        colors[x] = static_cast<u16>(first);
+        top_pixels[x] = first;
+        second_pixels[x] = second;
+    }
+}
+
+void PPU::CompositeScanline() {
+    // The lines are read as one block.
+    static_assert(sizeof(layer_lines) == std::tuple_size_v<decltype(layer_lines)> * sizeof(LayerLine));
+
+    using CompositeFunction = void (*)(const u32*, const u32*, const u32*, u32, u16*, u32*, u32*);
+    static const auto composite_functions = []<std::size_t... I>(std::index_sequence<I...>) {
+        return std::array<CompositeFunction, sizeof...(I)> {&CompositeLayerPixels<I>...};
+    }(std::make_index_sequence<std::tuple_size_v<decltype(layer_lines)> + 1>{});
+
+    const LayerPixel backdrop = GetLayerPixelAttributes(3, Layer::Backdrop) | pram.Read<u16>(0);
+    composite_functions[layer_line_count](layer_lines[0].data(), layer_line_window_bits.data(), window_line.data(), backdrop,
+                                          &framebuffer[vcount * GBA_SCREEN_WIDTH], top_layer_line.data(), second_layer_line.data());
+
+    // Most lines have no effects at all, and then the composited colors are already final.
+    if (static_cast<ColorSpecialEffect>(bldcnt.flags.effect) != ColorSpecialEffect::None || scanline_has_semi_transparent_sprites) {
+        BlendScanline();
+    }
+}
+
+// Applies the color special effects to every column, for the frontmost pixel and the one behind it.
+// Like CompositeLayerPixels(), it's written so that every step can be vectorized: all three
+// effects are worked out for every pixel, and the one that applies is picked at the end. For the
+// same reason the flags are 0 or 1 in a u32 rather than bools. Windows can turn effects off per column.
+TARGET_CLONES_SIMD
+void PPU::BlendLayerPixels(const LayerPixel* __restrict top_pixels, const LayerPixel* __restrict second_pixels,
+                           const u32* __restrict window_pixels, u16* __restrict colors,
+                           const u32 alpha_blending, const u32 brightness_change, const u32 brightness_increase,
+                           const u32 eva, const u32 evb, const u32 evy) {
+    for (std::size_t x = 0; x < GBA_SCREEN_WIDTH; x++) {
+        const LayerPixel top = top_pixels[x];
+        const LayerPixel second = second_pixels[x];
+
+        const u32 top_is_target = (top & FIRST_BLEND_TARGET) != 0;
+        const u32 top_is_semi_transparent = (top & SEMI_TRANSPARENT_OBJ) != 0;
+        // A column with nothing behind the top pixel keeps the transparent pixel as its second,
+        // which has every bit set, so bit 31 has to be checked before the target bit counts.
+        const u32 second_is_target = ((second & SECOND_BLEND_TARGET) != 0) & (~second >> 31);
+        const u32 effects_enabled = (window_pixels[x] >> WINDOW_EFFECTS_ENABLE_BIT) & 1;
+
+        // Semi-transparent sprites are blended whether or not alpha blending was selected,
+        // as long as there's a second target behind them.
+        const u32 blend = effects_enabled & second_is_target & (top_is_semi_transparent | (alpha_blending & top_is_target));
+        const u32 change_brightness = effects_enabled & (blend ^ 1) & brightness_change & top_is_target;
+
+        u32 blended_color = 0;
+        u32 changed_color = 0;
+
+        // One BGR555 channel at a time, unrolled for the same reason as in CompositeLayerPixels().
+#pragma GCC unroll 3
+        for (u32 shift = 0; shift < 15; shift += 5) {
+            const u32 a = (top >> shift) & 0x1F;
+            const u32 b = (second >> shift) & 0x1F;
+
+            blended_color |= std::min<u32>(0x1F, (a * eva + b * evb) >> 4) << shift;
+
+            const u32 increased = a + (((0x1F - a) * evy) >> 4);
+            const u32 decreased = a - ((a * evy) >> 4);
+            changed_color |= (brightness_increase ? increased : decreased) << shift;
+        }
+
+        const u32 color = blend ? blended_color : (change_brightness ? changed_color : (top & 0xFFFF));
+        colors[x] = static_cast<u16>(color);
+    }
+}
+
+void PPU::BlendScanline() {
+    const auto effect = static_cast<ColorSpecialEffect>(bldcnt.flags.effect);
+
+    // Coefficients are in 1/16ths, and anything above 16 counts as 16.
+    const u32 eva = std::min<u32>(bldalpha.flags.first_target_coefficient, 16);
+    const u32 evb = std::min<u32>(bldalpha.flags.second_target_coefficient, 16);
+    const u32 evy = std::min<u32>(bldy, 16);
+
+    BlendLayerPixels(top_layer_line.data(), second_layer_line.data(), window_line.data(), &framebuffer[vcount * GBA_SCREEN_WIDTH],
+                     effect == ColorSpecialEffect::AlphaBlending,
+                     effect == ColorSpecialEffect::BrightnessIncrease || effect == ColorSpecialEffect::BrightnessDecrease,
+                     effect == ColorSpecialEffect::BrightnessIncrease, eva, evb, evy);
+}
+
+void PPU::RenderWindowScanline() {
+    if (!dispcnt.flags.window0_display && !dispcnt.flags.window1_display && !dispcnt.flags.obj_window_display) {
+        window_line.fill(ALL_WINDOW_LAYERS_ENABLED);
+        return;
+    }
+
+    window_line.fill(Common::GetBitRange<0, 5>(winout));
+
+    // The OBJ window is made of the opaque pixels of the OBJ window sprites, which are only
+    // drawn to find out which those are.
+    if (scanline_obj_window_sprite_count != 0) {
+        obj_window_line.fill(TRANSPARENT_PIXEL);
+        for (std::size_t i = 0; i < scanline_sprite_count; i++) {
+            if (scanline_sprites[i].obj_window) {
+                RenderTiledSpriteScanline(scanline_sprites[i], obj_window_line);
+            }
+        }
+
+        const u32 obj_window_enables = Common::GetBitRange<8, 13>(winout);
+        for (std::size_t x = 0; x < GBA_SCREEN_WIDTH; x++) {
+            window_line[x] = obj_window_line[x] != TRANSPARENT_PIXEL ? obj_window_enables : window_line[x];
+        }
+    }
+
+    const auto apply_window = [this](const Window& window, const u32 enables) {
+        const bool on_line = window.top <= window.bottom ? (vcount >= window.top && vcount < window.bottom)
+                                                         : (vcount >= window.top || vcount < window.bottom);
+        if (!on_line) {
+            return;
+        }
+
+        const u32 left = std::min<u32>(window.left, GBA_SCREEN_WIDTH);
+        const u32 right = std::min<u32>(window.right, GBA_SCREEN_WIDTH);
+        if (left <= right) {
+            std::fill(window_line.begin() + left, window_line.begin() + right, enables);
+        } else {
+            std::fill(window_line.begin() + left, window_line.end(), enables);
+            std::fill(window_line.begin(), window_line.begin() + right, enables);
+        }
+    };
+
+    // WIN0 is in front of WIN1, which is in front of the OBJ window.
+    if (dispcnt.flags.window1_display) {
+        apply_window(windows[1], Common::GetBitRange<8, 13>(winin));
+    }
+    if (dispcnt.flags.window0_display) {
+        apply_window(windows[0], Common::GetBitRange<0, 5>(winin));
+    }
+}
+
 bool PPU::IsBGScreenDisplayEnabled(const std::size_t bg_no) const {
     switch (bg_no) {
         case 0:
@@ -155,116 +325,71 @@ bool PPU::IsBGScreenDisplayEnabled(const std::size_t bg_no) const {
     }
 }
 
-void PPU::RenderTiledBGScanlineByPriority(const std::size_t priority) {
-    for (std::size_t bg = 0; bg < bgs.size(); bg++) {
-        if (!IsBGScreenDisplayEnabled(bg)) {
-            continue;
-        }
-
-        if (bgs[bg].control.flags.bg_priority == priority) {
-            RenderTiledBGScanline(bg);
-        }
-    }
-}
-
 void PPU::RenderTiledBGScanline(const std::size_t bg_no) {
     const BG& bg = bgs.at(bg_no);
 
     const u32 tile_map_base = bg.control.flags.screen_base_block * 0x800;
+    const bool wide_map = Common::IsBitSet<0>(bg.control.flags.screen_size);
+    const bool tall_map = Common::IsBitSet<1>(bg.control.flags.screen_size);
+    const u16 map_width = wide_map ? 512 : 256;
+
+    const u16 map_y = (vcount + bg.y_offset) % (tall_map ? 512 : 256);
+    const std::size_t tile_y = map_y % TILE_HEIGHT;
+
+    // The map is made of 256x256 screen blocks of 32x32 tile entries each, stored left to
+    // right and then top to bottom.
+    u32 map_row_address = tile_map_base + ((map_y % 256) / TILE_HEIGHT * 32) * sizeof(u16);
+    if (map_y >= 256) {
+        map_row_address += wide_map ? 0x1000 : 0x800;
+    }
 
-    for (u16 screen_x = 0; screen_x < GBA_SCREEN_WIDTH; screen_x++) {
-        const u16 map_x = (screen_x + bg.x_offset) % (Common::IsBitSet<0>(bg.control.flags.screen_size) ? 512 : 256);
-        const u16 map_y = (vcount + bg.y_offset) % (Common::IsBitSet<1>(bg.control.flags.screen_size) ? 512 : 256);
+    const auto layer = static_cast<Layer>(static_cast<std::size_t>(Layer::BG0) + bg_no);
+    LayerLine& line = AddLayerLine(layer);
+    const LayerPixel attributes = GetLayerPixelAttributes(bg.control.flags.bg_priority, layer);
+    u16 map_x = bg.x_offset % map_width;
 
-        auto tile_address = tile_map_base + ((map_x / TILE_WIDTH) + (map_y / TILE_HEIGHT * 32)) * sizeof(u16);
+    // Draw a tile row at a time. Only the first and last spans can be narrower than a tile.
+    for (std::size_t screen_x = 0; screen_x < GBA_SCREEN_WIDTH;) {
+        const std::size_t tile_x = map_x % TILE_WIDTH;
+        const std::size_t span_width = std::min<std::size_t>(TILE_WIDTH - tile_x, GBA_SCREEN_WIDTH - screen_x);
+
+        u32 tile_address = map_row_address + ((map_x % 256) / TILE_WIDTH) * sizeof(u16);
         if (map_x >= 256) {
-            tile_address = (tile_map_base + (((map_x - 256) / TILE_WIDTH) + (map_y / TILE_HEIGHT * 32)) * sizeof(u16)) + 0x800;
+            tile_address += 0x800;
         }
-        // TODO: map_y >= 256
 
-        u16 tile_entry = ReadVRAM<u16>(tile_address);
+        const u16 tile_entry = vram.Read<u16>(tile_address);
         const u16 tile_index = Common::GetBitRange<0, 9>(tile_entry);
-        const Tile& tile = ConstructBGTile(bg, tile_index);
-
-        const std::size_t tile_x = map_x % TILE_WIDTH;
-        const std::size_t tile_y = map_y % TILE_HEIGHT;
+        const Tile& tile = GetBGTile(bg, tile_index);
 
         const bool vertical_flip = Common::IsBitSet<11>(tile_entry);
-        const std::size_t real_tile_y = vertical_flip ? ((TILE_HEIGHT - 1) - tile_y) : tile_y;
-
+        const auto& tile_row = tile[vertical_flip ? ((TILE_HEIGHT - 1) - tile_y) : tile_y];
         const bool horizontal_flip = Common::IsBitSet<10>(tile_entry);
-        const std::size_t real_tile_x = horizontal_flip ? ((TILE_WIDTH - 1) - tile_x) : tile_x;
-
-        // Color 0 is used for transparency.
-        if (tile[real_tile_y][real_tile_x] == 0) {
-            continue;
-        }
 
         u16 palette_index = Common::GetBitRange<12, 15>(tile_entry);
         if (bg.control.flags.use_256_colors) {
             palette_index = 0;
         }
-        const auto pram_addr = ((palette_index << 4) | tile[real_tile_y][real_tile_x]) * sizeof(u16);
-        const std::size_t framebuffer_pixel_position = (vcount * GBA_SCREEN_WIDTH) + screen_x;
-        framebuffer.at(framebuffer_pixel_position) = ReadPRAM<u16>(pram_addr);
-    }
-}
-
-void PPU::RenderTiledSpriteScanlineByPriority(const std::size_t priority) {
-    if (!dispcnt.flags.screen_display_obj) {
-        return;
-    }
 
-    for (int sprite_no = 127; sprite_no >= 0; sprite_no--) {
-        const Sprite sprite = {
-            .attributes = {
-                ReadOAM<u16>((sprite_no * 8) + 0),
-                ReadOAM<u16>((sprite_no * 8) + 2),
-                ReadOAM<u16>((sprite_no * 8) + 4),
-            },
-        };
+        for (std::size_t i = 0; i < span_width; i++) {
+            const std::size_t x = tile_x + i;
+            const u8 color_index = tile_row[horizontal_flip ? ((TILE_WIDTH - 1) - x) : x];
 
-        // Skip to the next sprite if the rotation/scaling flag is disabled and the OBJ disabled flag is enabled.
-        if (!Common::IsBitSet<8>(sprite.attributes[0])) {
-            if (Common::IsBitSet<9>(sprite.attributes[0])) {
+            // Color 0 is used for transparency.
+            if (color_index == 0) {
                 continue;
             }
-        }
 
-        const u16 sprite_priority = Common::GetBitRange<10, 11>(sprite.attributes[2]);
-        if (priority == sprite_priority) {
-            RenderTiledSpriteScanline(sprite);
+            const u16 color = pram.Read<u16>(((palette_index << 4) | color_index) * sizeof(u16));
+            line[screen_x + i] = attributes | color;
         }
-    }
-}
 
-std::size_t PPU::DetermineTileInSprite(const Sprite& sprite, const u16 screen_x, const u16 screen_y, const u16 sprite_x, const u16 sprite_y, const u16 width, const u16 height) {
-    const auto width_in_tiles = width / TILE_WIDTH;
-    const auto height_in_tiles = height / TILE_HEIGHT;
-
-    auto sprite_map_x = (screen_x - sprite_x) / TILE_WIDTH;
-    ASSERT(sprite_map_x < width_in_tiles);
-    auto sprite_map_y = (screen_y - sprite_y) / TILE_HEIGHT;
-    ASSERT(sprite_map_y < height_in_tiles);
-
-    if (width_in_tiles == 1 && height_in_tiles == 1) {
-        return 0;
-    }
-
-    const bool horizontal_flip = Common::IsBitSet<12>(sprite.attributes[1]);
-    if (horizontal_flip && width_in_tiles != 1) {
-        sprite_map_x = width_in_tiles - sprite_map_x - 1;
-    }
-
-    const bool vertical_flip = Common::IsBitSet<13>(sprite.attributes[1]);
-    if (vertical_flip && height_in_tiles != 1) {
-        sprite_map_y = height_in_tiles - sprite_map_y - 1;
+        screen_x += span_width;
+        map_x = (map_x + span_width) % map_width;
     }
-
-    return sprite_map_y * width_in_tiles + sprite_map_x;
 }
 
-void PPU::RenderTiledSpriteScanline(const Sprite& sprite) {
+void PPU::EvaluateSprites() {
     enum class SpriteShape {
         Square,
         Horizontal,
@@ -272,145 +397,238 @@ void PPU::RenderTiledSpriteScanline(const Sprite& sprite) {
         Forbidden,
     };
 
-    const std::unsigned_integral auto x = Common::GetBitRange<0, 8>(sprite.attributes[1]);
-    const std::unsigned_integral auto y = Common::GetBitRange<0, 7>(sprite.attributes[0]);
+    scanline_sprite_count = 0;
+    scanline_has_semi_transparent_sprites = false;
+    scanline_obj_window_sprite_count = 0;
 
-    if (x >= GBA_SCREEN_WIDTH || y >= GBA_SCREEN_HEIGHT) {
+    if (!dispcnt.flags.screen_display_obj) {
         return;
     }
 
-    const auto shape = SpriteShape(Common::GetBitRange<14, 15>(sprite.attributes[0]));
-    const std::unsigned_integral auto size = Common::GetBitRange<14, 15>(sprite.attributes[1]);
-
-    u8 width = 0;
-    u8 height = 0;
+    for (int sprite_no = 127; sprite_no >= 0; sprite_no--) {
+        const std::array<u16, 3> attributes = {
+            oam.Read<u16>((sprite_no * 8) + 0),
+            oam.Read<u16>((sprite_no * 8) + 2),
+            oam.Read<u16>((sprite_no * 8) + 4),
+        };
 
-    switch (shape) {
-        case SpriteShape::Square:
-            switch (size) {
-                case 0: width = 8; height = 8; break;
-                case 1: width = 16; height = 16; break;
-                case 2: width = 32; height = 32; break;
-                case 3: width = 64; height = 64; break;
-                default: UNREACHABLE();
-            }
-            break;
-        case SpriteShape::Horizontal:
-            switch (size) {
-                case 0: width = 16; height = 8; break;
-                case 1: width = 32; height = 8; break;
-                case 2: width = 32; height = 16; break;
-                case 3: width = 64; height = 32; break;
-                default: UNREACHABLE();
-            }
-            break;
-        case SpriteShape::Vertical:
-            switch (size) {
-                case 0: width = 8; height = 16; break;
-                case 1: width = 8; height = 32; break;
-                case 2: width = 16; height = 32; break;
-                case 3: width = 32; height = 64; break;
-                default: UNREACHABLE();
+        // Skip to the next sprite if the rotation/scaling flag is disabled and the OBJ disabled flag is enabled.
+        if (!Common::IsBitSet<8>(attributes[0])) {
+            if (Common::IsBitSet<9>(attributes[0])) {
+                continue;
             }
-            break;
-        case SpriteShape::Forbidden:
-        default:
-            UNIMPLEMENTED_MSG("Unimplemented sprite shape {}", Common::GetUnderlyingValue(shape));
-    }
-
-    if (vcount < y || vcount >= y + height) {
-        return;
-    }
+        }
 
-    for (std::size_t screen_x = 0; screen_x < GBA_SCREEN_WIDTH; screen_x++) {
-        if (screen_x < x || screen_x >= x + width) {
+        // OBJ window sprites do nothing at all while the OBJ window is off.
+        const u8 mode = Common::GetBitRange<10, 11>(attributes[0]);
+        if (mode == 2 && !dispcnt.flags.obj_window_display) {
             continue;
         }
 
-        const bool use_256_colors = Common::IsBitSet<13>(sprite.attributes[0]);
+        const std::unsigned_integral auto x = Common::GetBitRange<0, 8>(attributes[1]);
+        const std::unsigned_integral auto y = Common::GetBitRange<0, 7>(attributes[0]);
 
-        std::unsigned_integral auto tile_index = Common::GetBitRange<0, 9>(sprite.attributes[2]);
-        if (use_256_colors) {
-            tile_index /= 2;
-        }
-        const std::size_t which_tile = DetermineTileInSprite(sprite, screen_x, vcount, x, y, width, height);
-        const Tile& tile = ConstructSpriteTile(sprite, tile_index + which_tile);
+        const auto shape = SpriteShape(Common::GetBitRange<14, 15>(attributes[0]));
+        const std::unsigned_integral auto size = Common::GetBitRange<14, 15>(attributes[1]);
 
-        const auto tile_x = (screen_x - x) % TILE_WIDTH;
-        const auto tile_y = (vcount - y) % TILE_HEIGHT;
+        u8 width = 0;
+        u8 height = 0;
 
-        const auto real_tile_x = Common::IsBitSet<12>(sprite.attributes[1]) ? (7 - tile_x) : tile_x;
-        const auto real_tile_y = Common::IsBitSet<13>(sprite.attributes[1]) ? (7 - tile_y) : tile_y;
+        switch (shape) {
+            case SpriteShape::Square:
+                switch (size) {
+                    case 0: width = 8; height = 8; break;
+                    case 1: width = 16; height = 16; break;
+                    case 2: width = 32; height = 32; break;
+                    case 3: width = 64; height = 64; break;
+                    default: UNREACHABLE();
+                }
+                break;
+            case SpriteShape::Horizontal:
+                switch (size) {
+                    case 0: width = 16; height = 8; break;
+                    case 1: width = 32; height = 8; break;
+                    case 2: width = 32; height = 16; break;
+                    case 3: width = 64; height = 32; break;
+                    default: UNREACHABLE();
+                }
+                break;
+            case SpriteShape::Vertical:
+                switch (size) {
+                    case 0: width = 8; height = 16; break;
+                    case 1: width = 8; height = 32; break;
+                    case 2: width = 16; height = 32; break;
+                    case 3: width = 32; height = 64; break;
+                    default: UNREACHABLE();
+                }
+                break;
+            case SpriteShape::Forbidden:
+            default:
+                UNIMPLEMENTED_MSG("Unimplemented sprite shape {}", Common::GetUnderlyingValue(shape));
+        }
 
-        if (tile[real_tile_y][real_tile_x] == 0) {
+        // The line the sprite starts on can be below this one if it wraps around from the bottom.
+        if (static_cast<u8>(vcount - y) >= height) {
             continue;
         }
 
-        u16 palette_index = 0;
-        if (!use_256_colors) {
-            palette_index = Common::GetBitRange<12, 15>(sprite.attributes[2]);
+        const s16 wrapped_x = x >= 256 ? x - 512 : x;
+        if (wrapped_x >= static_cast<s16>(GBA_SCREEN_WIDTH) || wrapped_x + width <= 0) {
+            continue;
         }
-        const auto pram_addr = ((palette_index << 4) | tile[real_tile_y][real_tile_x]) * sizeof(u16);
-        framebuffer.at((vcount * GBA_SCREEN_WIDTH) + screen_x) = ReadPRAM<u16>(0x200 + pram_addr);
+
+        Sprite& sprite = scanline_sprites[scanline_sprite_count++];
+        sprite.x = wrapped_x;
+        sprite.y = y;
+        sprite.width = width;
+        sprite.height = height;
+        sprite.use_256_colors = Common::IsBitSet<13>(attributes[0]);
+        sprite.tile_number = Common::GetBitRange<0, 9>(attributes[2]);
+        if (sprite.use_256_colors) {
+            // 8bpp tiles take up two tile numbers, and the lower one always has to be even.
+            sprite.tile_number &= ~1;
+        }
+        sprite.palette_index = sprite.use_256_colors ? 0 : Common::GetBitRange<12, 15>(attributes[2]);
+        sprite.priority = Common::GetBitRange<10, 11>(attributes[2]);
+        sprite.horizontal_flip = Common::IsBitSet<12>(attributes[1]);
+        sprite.vertical_flip = Common::IsBitSet<13>(attributes[1]);
+        sprite.semi_transparent = mode == 1;
+        sprite.obj_window = mode == 2;
+        scanline_has_semi_transparent_sprites |= sprite.semi_transparent;
+        scanline_obj_window_sprite_count += sprite.obj_window;
     }
 }
 
-PPU::Tile PPU::ConstructBGTile(const BG& bg, const u16 tile_index) {
-    const u32 tile_data_base = bg.control.flags.character_base_block * 0x4000;
-    const std::size_t tile_size = bg.control.flags.use_256_colors ? 64 : 32;
-    const u32 tile_base = tile_data_base + (tile_index * tile_size);
+void PPU::RenderSpriteLayerScanline() {
+    EvaluateSprites();
+    if (scanline_sprite_count == scanline_obj_window_sprite_count) {
+        return;
+    }
+
+    LayerLine& line = AddLayerLine(Layer::OBJ);
+
+    for (std::size_t i = 0; i < scanline_sprite_count; i++) {
+        if (!scanline_sprites[i].obj_window) {
+            RenderTiledSpriteScanline(scanline_sprites[i], line);
+        }
+    }
+}
 
-    Tile tile {};
+void PPU::RenderTiledSpriteScanline(const Sprite& sprite, LayerLine& line) {
+    const u8 tile_step = sprite.use_256_colors ? 2 : 1;
+    const u8 width_in_tiles = sprite.width / TILE_WIDTH;
 
-    std::vector<u8> tile_data(tile_size);
-    std::copy(vram.data() + tile_base, vram.data() + tile_base + tile_size, tile_data.data());
+    const u8 sprite_y = vcount - sprite.y;
+    const u8 row = sprite.vertical_flip ? (sprite.height - 1 - sprite_y) : sprite_y;
+    const std::size_t tile_y = row % TILE_HEIGHT;
 
-    if (bg.control.flags.use_256_colors) {
-        for (std::size_t y = 0; y < TILE_HEIGHT; y++) {
-            for (std::size_t x = 0; x < TILE_WIDTH; x++) {
-                tile[y][x] = tile_data.at((y * TILE_WIDTH) + x);
+    // With 1D mapping the sprite's tiles follow each other in VRAM. With 2D mapping each row
+    // of tiles starts 32 tiles after the previous one, as if OBJ VRAM was a 32x32 tile sheet.
+    const u16 tiles_per_row = dispcnt.flags.obj_character_vram_mapping ? width_in_tiles * tile_step : 32;
+    const u16 row_tile_number = sprite.tile_number + (row / TILE_HEIGHT) * tiles_per_row;
+
+    LayerPixel attributes = GetLayerPixelAttributes(sprite.priority, Layer::OBJ);
+    if (sprite.semi_transparent) {
+        attributes |= SEMI_TRANSPARENT_OBJ;
+    }
+
+    const s32 start_x = std::max<s32>(sprite.x, 0);
+    const s32 end_x = std::min<s32>(sprite.x + sprite.width, GBA_SCREEN_WIDTH);
+    // Draw a tile row at a time. Only the spans cut off by the screen edges are narrower than a tile.
+    for (s32 screen_x = start_x; screen_x < end_x;) {
+        const u32 sprite_x = screen_x - sprite.x;
+        const u32 tile_x = sprite_x % TILE_WIDTH;
+        const s32 span_width = std::min<s32>(TILE_WIDTH - tile_x, end_x - screen_x);
+
+        const u32 column = sprite.horizontal_flip ? (sprite.width - 1 - sprite_x) : sprite_x;
+        const u16 tile_number = (row_tile_number + (column / TILE_WIDTH) * tile_step) & 0x3FF;
+        const auto& tile_row = GetSpriteTile(sprite, tile_number)[tile_y];
+
+        for (s32 i = 0; i < span_width; i++) {
+            const std::size_t x = tile_x + i;
+            const u8 color_index = tile_row[sprite.horizontal_flip ? ((TILE_WIDTH - 1) - x) : x];
+
+            if (color_index == 0) {
+                continue;
             }
-        }
-    } else {
-        for (std::size_t y = 0; y < TILE_HEIGHT; y++) {
-            for (std::size_t x = 0; x < TILE_WIDTH; x += 2) {
-                const auto tile_data_index = (y * (TILE_WIDTH / 2)) + (x / 2);
-                tile[y][x + 0] = tile_data.at(tile_data_index) & 0xF;
-                tile[y][x + 1] = tile_data.at(tile_data_index) >> 4;
+
+            // Sprites are drawn from the highest OAM index down, and a sprite covers the ones
+            // drawn before it unless they have a higher priority (a lower value).
+            if ((attributes >> 29) <= (line[screen_x + i] >> 29)) {
+                const u16 color = pram.Read<u16>(0x200 + ((sprite.palette_index << 4) | color_index) * sizeof(u16));
+                line[screen_x + i] = attributes | color;
             }
         }
+
+        screen_x += span_width;
     }
+}
 
-    return tile;
+void PPU::InvalidateTiles(const u32 first, const u32 last) {
+    for (std::size_t i = first / 32; i <= last / 32 && i < TILE_4BPP_COUNT; i++) {
+        dirty_tiles_4bpp[i] = true;
+    }
+
+    for (std::size_t i = first / 64; i <= last / 64 && i < TILE_8BPP_COUNT; i++) {
+        dirty_tiles_8bpp[i] = true;
+    }
 }
 
-PPU::Tile PPU::ConstructSpriteTile(const Sprite& sprite, const u16 tile_index) {
-    const u32 tile_data_base = 0x10000;
+// Spreads the 8 nibbles of a 4bpp row into the 8 bytes of a u64, several pixels at a time.
+static constexpr u64 ExpandNibbles(const u32 row) {
+    u64 pixels = row;
+    pixels = (pixels | (pixels << 16)) & 0x0000FFFF0000FFFF;
+    pixels = (pixels | (pixels << 8)) & 0x00FF00FF00FF00FF;
+    pixels = (pixels | (pixels << 4)) & 0x0F0F0F0F0F0F0F0F;
+    return pixels;
+}
+
+static_assert(ExpandNibbles(0x76543210) == 0x0706050403020100);
 
-    const bool use_256_colors = Common::IsBitSet<13>(sprite.attributes[0]);
+const PPU::Tile& PPU::GetTile(const u32 tile_base, const bool use_256_colors) {
     const std::size_t tile_size = use_256_colors ? 64 : 32;
-    const u32 tile_base = tile_data_base + (tile_index * tile_size);
 
-    Tile tile {};
+    // Tiles past the end of VRAM are transparent.
+    if (tile_base + tile_size > vram.GetSize()) {
+        static constexpr Tile empty_tile {};
+        return empty_tile;
+    }
 
-    std::vector<u8> tile_data(tile_size);
-    std::copy(vram.data() + tile_base, vram.data() + tile_base + tile_size, tile_data.data());
+    const std::size_t tile_no = tile_base / tile_size;
+    const u8* tile_data = vram.GetData() + tile_base;
 
     if (use_256_colors) {
-        for (std::size_t y = 0; y < TILE_HEIGHT; y++) {
-            for (std::size_t x = 0; x < TILE_WIDTH; x++) {
-                tile[y][x] = tile_data.at((y * TILE_WIDTH) + x);
-            }
+        Tile& tile = tiles_8bpp[tile_no];
+        if (dirty_tiles_8bpp[tile_no]) {
+            std::memcpy(tile.data(), tile_data, sizeof(Tile));
+            dirty_tiles_8bpp[tile_no] = false;
         }
-    } else {
+
+        return tile;
+    }
+
+    Tile& tile = tiles_4bpp[tile_no];
+    if (dirty_tiles_4bpp[tile_no]) {
         for (std::size_t y = 0; y < TILE_HEIGHT; y++) {
-            for (std::size_t x = 0; x < TILE_WIDTH; x += 2) {
-                const auto tile_data_index = (y * (TILE_WIDTH / 2)) + (x / 2);
-                tile[y][x + 0] = tile_data.at(tile_data_index) & 0xF;
-                tile[y][x + 1] = tile_data.at(tile_data_index) >> 4;
-            }
+            u32 row;
+            std::memcpy(&row, tile_data + y * sizeof(u32), sizeof(u32));
+            const u64 pixels = ExpandNibbles(row);
+            std::memcpy(tile[y].data(), &pixels, sizeof(u64));
         }
+
+        dirty_tiles_4bpp[tile_no] = false;
     }
 
     return tile;
 }
+
+const PPU::Tile& PPU::GetBGTile(const BG& bg, const u16 tile_index) {
+    const u32 tile_data_base = bg.control.flags.character_base_block * 0x4000;
+    const std::size_t tile_size = bg.control.flags.use_256_colors ? 64 : 32;
+    return GetTile(tile_data_base + (tile_index * tile_size), bg.control.flags.use_256_colors);
+}
+
+const PPU::Tile& PPU::GetSpriteTile(const Sprite& sprite, const u16 tile_number) {
+    const u32 tile_data_base = 0x10000;
+    return GetTile(tile_data_base + (tile_number * 32), sprite.use_256_colors);
+}
@@ -1,8 +1,9 @@
 #pragma once
 
-#include <deque>
-#include <functional>
+#include <array>
 #include "common/bits.h"
+#include "common/defines.h"
+#include "common/memory_region.h"
 #include "common/types.h"
 
 constexpr u32 GBA_SCREEN_WIDTH = 240;
@@ -10,13 +11,15 @@ constexpr u32 GBA_SCREEN_HEIGHT = 160;
 
 class Bus;
 class Interrupts;
+class Scheduler;
 
 class PPU {
 public:
-    PPU(Bus& bus_, Interrupts& interrupts_);
+    PPU(Bus& bus_, Interrupts& interrupts_, Scheduler& scheduler_);
 
-    void AdvanceCycles(u16 cycles);
-    void Tick();
+    // Stops frames from being presented and frontend events from being polled, for systems
+    // that run in the background such as the lockstep reference.
+    void DetachFrontend() { frontend_attached = false; }
 
     [[nodiscard]] u16 GetDISPCNT() const { return dispcnt.raw; }
     void SetDISPCNT(u16 value) { dispcnt.raw = value; }
@@ -28,6 +31,34 @@ public:
 
     [[nodiscard]] u16 GetVCOUNT() const { return vcount; }
 
+    [[nodiscard]] u16 GetBLDCNT() const { return bldcnt.raw; }
+    void SetBLDCNT(const u16 value) { bldcnt.raw = value & 0x3FFF; }
+
+    [[nodiscard]] u16 GetBLDALPHA() const { return bldalpha.raw; }
+    void SetBLDALPHA(const u16 value) { bldalpha.raw = value & 0x1F1F; }
+
+    void SetBLDY(const u16 value) { bldy = value & 0x1F; }
+
+    template <u8 window_no>
+    void SetWINH(const u16 value) {
+        static_assert(window_no < 2);
+        windows[window_no].right = Common::GetBitRange<0, 7>(value);
+        windows[window_no].left = Common::GetBitRange<8, 15>(value);
+    }
+
+    template <u8 window_no>
+    void SetWINV(const u16 value) {
+        static_assert(window_no < 2);
+        windows[window_no].bottom = Common::GetBitRange<0, 7>(value);
+        windows[window_no].top = Common::GetBitRange<8, 15>(value);
+    }
+
+    [[nodiscard]] u16 GetWININ() const { return winin; }
+    void SetWININ(const u16 value) { winin = value & 0x3F3F; }
+
+    [[nodiscard]] u16 GetWINOUT() const { return winout; }
+    void SetWINOUT(const u16 value) { winout = value & 0x3F3F; }
+
     template <u8 bg_no>
     [[nodiscard]] u16 GetBGCNT() const {
         static_assert(bg_no < 4);
@@ -68,151 +99,21 @@ public:
         bgs[bg_no].y_offset = Common::GetBitRange<0, 9>(value);
     }
 
-    template <UnsignedIntegerMax32 T>
-    [[nodiscard]] T ReadVRAM(u32 addr) const {
-        if constexpr (std::is_same_v<T, u8>) {
-            return vram.at(addr);
-        }
-
-        if constexpr (std::is_same_v<T, u16>) {
-            addr &= ~0b1;
-            return (vram.at(addr) |
-                   (vram.at(addr + 1) << 8));
-        }
-
-        if constexpr (std::is_same_v<T, u32>) {
-            addr &= ~0b11;
-            return (vram.at(addr) |
-                   (vram.at(addr + 1) << 8) |
-                   (vram.at(addr + 2) << 16) |
-                   (vram.at(addr + 3) << 24));
-        }
-    }
-
-    template <UnsignedIntegerMax32 T>
-    void WriteVRAM(u32 addr, T value) {
-        if constexpr (std::is_same_v<T, u8>) {
-            addr &= ~0b1;
-            vram.at(addr) = value;
-            vram.at(addr + 1) = value;
-        }
-
-        if constexpr (std::is_same_v<T, u16>) {
-            addr &= ~0b1;
-            vram.at(addr + 0) = Common::GetBitRange<7, 0>(value);
-            vram.at(addr + 1) = Common::GetBitRange<15, 8>(value);
-        }
-
-        if constexpr (std::is_same_v<T, u32>) {
-            addr &= ~0b11;
-            vram.at(addr + 0) = Common::GetBitRange<7, 0>(value);
-            vram.at(addr + 1) = Common::GetBitRange<15, 8>(value);
-            vram.at(addr + 2) = Common::GetBitRange<23, 16>(value);
-            vram.at(addr + 3) = Common::GetBitRange<31, 24>(value);
-        }
-    }
-
-    template <UnsignedIntegerMax32 T>
-    [[nodiscard]] T ReadPRAM(u32 addr) const {
-        if constexpr (std::is_same_v<T, u8>) {
-            return pram.at(addr);
-        }
-
-        if constexpr (std::is_same_v<T, u16>) {
-            addr &= ~0b1;
-            return (pram.at(addr) |
-                   (pram.at(addr + 1) << 8));
-        }
-
-        if constexpr (std::is_same_v<T, u32>) {
-            addr &= ~0b11;
-            return (pram.at(addr) |
-                   (pram.at(addr + 1) << 8) |
-                   (pram.at(addr + 2) << 16) |
-                   (pram.at(addr + 3) << 24));
-        }
-    }
-
-    template <UnsignedIntegerMax32 T>
-    void WritePRAM(u32 addr, T value) {
-        if constexpr (std::is_same_v<T, u8>) {
-            addr &= ~0b1;
-            pram.at(addr) = value;
-            pram.at(addr + 1) = value;
-        }
-
-        if constexpr (std::is_same_v<T, u16>) {
-            addr &= ~0b1;
-            pram.at(addr + 0) = Common::GetBitRange<7, 0>(value);
-            pram.at(addr + 1) = Common::GetBitRange<15, 8>(value);
-        }
-
-        if constexpr (std::is_same_v<T, u32>) {
-            addr &= ~0b11;
-            pram.at(addr + 0) = Common::GetBitRange<7, 0>(value);
-            pram.at(addr + 1) = Common::GetBitRange<15, 8>(value);
-            pram.at(addr + 2) = Common::GetBitRange<23, 16>(value);
-            pram.at(addr + 3) = Common::GetBitRange<31, 24>(value);
-        }
-    }
-
-    template <UnsignedIntegerMax32 T>
-    [[nodiscard]] T ReadOAM(u32 addr) const {
-        if constexpr (std::is_same_v<T, u8>) {
-            return oam.at(addr);
-        }
-
-        if constexpr (std::is_same_v<T, u16>) {
-            addr &= ~0b1;
-            return (oam.at(addr) |
-                   (oam.at(addr + 1) << 8));
-        }
-
-        if constexpr (std::is_same_v<T, u32>) {
-            addr &= ~0b11;
-            return (oam.at(addr) |
-                   (oam.at(addr + 1) << 8) |
-                   (oam.at(addr + 2) << 16) |
-                   (oam.at(addr + 3) << 24));
-        }
-    }
-
-    template <UnsignedIntegerMax32 T>
-    void WriteOAM(u32 addr, const T value) {
-        if constexpr (std::is_same_v<T, u8>) {
-            oam.at(addr) = value;
-        }
-
-        if constexpr (std::is_same_v<T, u16>) {
-            addr &= ~0b1;
-            oam.at(addr + 0) = Common::GetBitRange<7, 0>(value);
-            oam.at(addr + 1) = Common::GetBitRange<15, 8>(value);
-        }
-
-        if constexpr (std::is_same_v<T, u32>) {
-            addr &= ~0b11;
-            oam.at(addr + 0) = Common::GetBitRange<7, 0>(value);
-            oam.at(addr + 1) = Common::GetBitRange<15, 8>(value);
-            oam.at(addr + 2) = Common::GetBitRange<23, 16>(value);
-            oam.at(addr + 3) = Common::GetBitRange<31, 24>(value);
-        }
-    }
-
 private:
-    std::array<u8, 0x18000> vram {};
-    std::array<u8, 0x400> pram {};
-    std::array<u8, 0x400> oam {};
+    friend class Bus;
+    friend class Scheduler;
+
+    // VRAM is 96 KB, which doesn't mirror with a mask. The Bus takes care of that before accessing it.
+    MemoryRegion<0x18000, 0x1FFFF, ByteWriteBehavior::Duplicate> vram;
+    MemoryRegion<0x400, 0x3FF, ByteWriteBehavior::Duplicate> pram;
+    MemoryRegion<0x400, 0x3FF, ByteWriteBehavior::Ignore> oam;
     std::array<u16, GBA_SCREEN_WIDTH * GBA_SCREEN_HEIGHT> framebuffer {};
 
     Bus& bus;
     Interrupts& interrupts;
+    Scheduler& scheduler;
 
-    u64 vcycles = 0;
-
-    using SchedulerEntry = std::pair<u64, std::function<void()>>;
-    std::deque<SchedulerEntry> scheduler_entries;
-
-    void ScheduleNewFunction(u64 cycles_from_now, const std::function<void()>& function);
+    bool frontend_attached = true;
 
     void StartNewScanline();
     void StartHBlank();
@@ -221,17 +122,112 @@ private:
 
     void RenderScanline();
 
+    // The layers a pixel can come from, from the one that wins at equal priority to the one that loses.
+    enum class Layer : u8 {
+        OBJ,
+        BG0,
+        BG1,
+        BG2,
+        BG3,
+        Backdrop,
+    };
+
+    // Every layer is drawn into its own line buffer, and the buffers are composited at the end.
+    // Pixels in them are laid out so that the frontmost pixel is the one with the lowest value:
+    //   bit 31:     set for transparent pixels (which are all ones)
+    //   bits 30-29: priority
+    //   bits 28-26: layer
+    //   bit 18:     semi-transparent OBJ
+    //   bit 17:     second blend target
+    //   bit 16:     first blend target
+    //   bits 15-0:  color
+    // Only the priority and layer ever decide which pixel wins, since no two pixels of a line
+    // come from the same layer.
+    using LayerPixel = u32;
+    using LayerLine = std::array<LayerPixel, GBA_SCREEN_WIDTH>;
+
+    static constexpr LayerPixel TRANSPARENT_PIXEL = 0xFFFFFFFF;
+    static constexpr LayerPixel FIRST_BLEND_TARGET = 1 << 16;
+    static constexpr LayerPixel SECOND_BLEND_TARGET = 1 << 17;
+    static constexpr LayerPixel SEMI_TRANSPARENT_OBJ = 1 << 18;
+
+    // The bit of a layer in BLDCNT's target fields, which is also its bit in the window enables.
+    [[nodiscard]] static constexpr u32 GetLayerBit(const Layer layer) {
+        switch (layer) {
+            case Layer::OBJ:
+                return 4;
+            case Layer::Backdrop:
+                return 5;
+            default:
+                return static_cast<u32>(layer) - static_cast<u32>(Layer::BG0);
+        }
+    }
+
+    // Everything but the color, for the pixels of a layer with the given priority.
+    [[nodiscard]] LayerPixel GetLayerPixelAttributes(u8 priority, Layer layer) const;
+
+    // The lines of the layers that have something on the current scanline, in no particular
+    // order since pixels already say which layer they're from. At most four BGs and OBJ.
+    std::array<LayerLine, 5> layer_lines {};
+    // The window enable bit of the layer each line belongs to.
+    std::array<u32, 5> layer_line_window_bits {};
+    std::size_t layer_line_count = 0;
+    // The frontmost pixel of every column, and the one right behind it that it can be blended with.
+    LayerLine top_layer_line {};
+    LayerLine second_layer_line {};
+
+    // Returns the next free line for the given layer, cleared to transparent pixels.
+    LayerLine& AddLayerLine(Layer layer);
+    void CompositeScanline();
+    void BlendScanline();
+    static void BlendLayerPixels(const LayerPixel* __restrict top_pixels, const LayerPixel* __restrict second_pixels,
+                                 const u32* __restrict window_pixels, u16* __restrict colors,
+                                 u32 alpha_blending, u32 brightness_change, u32 brightness_increase, u32 eva, u32 evb, u32 evy);
+
+    // For every column, the enable bits (BG0-3, OBJ and color effects, like WININ and WINOUT)
+    // of the window it's in. Everything is enabled when no window is.
+    static constexpr u32 ALL_WINDOW_LAYERS_ENABLED = 0x3F;
+    static constexpr u32 WINDOW_EFFECTS_ENABLE_BIT = 5;
+    std::array<u32, GBA_SCREEN_WIDTH> window_line {};
+    // Scratch line the OBJ window sprites are drawn into to find out what they cover.
+    LayerLine obj_window_line {};
+
+    void RenderWindowScanline();
+
     [[nodiscard]] bool IsBGScreenDisplayEnabled(std::size_t bg_no) const;
-    void RenderTiledBGScanlineByPriority(std::size_t priority);
     void RenderTiledBGScanline(std::size_t bg_no);
 
+    // An OAM entry with its attributes decoded.
     struct Sprite {
-        std::array<u16, 3> attributes {};
+        // Sprites that hang off the right or bottom edge of the 512x256 OBJ plane wrap around,
+        // so x can be negative.
+        s16 x;
+        u8 y;
+        u8 width;
+        u8 height;
+        // Of the top left tile, in 32 byte units.
+        u16 tile_number;
+        u8 palette_index;
+        u8 priority;
+        bool use_256_colors;
+        bool horizontal_flip;
+        bool vertical_flip;
+        bool semi_transparent;
+        // Only shapes the OBJ window, and isn't drawn.
+        bool obj_window;
     };
 
-    std::size_t DetermineTileInSprite(const Sprite& sprite, u16 screen_x, u16 screen_y, u16 sprite_x, u16 sprite_y, u16 width, u16 height);
-    void RenderTiledSpriteScanlineByPriority(std::size_t priority);
-    void RenderTiledSpriteScanline(const Sprite& sprite);
+    // The sprites on the current scanline, from the one drawn first (highest OAM index) to the
+    // one drawn last. Built once per line, before any of the priority passes.
+    std::array<Sprite, 128> scanline_sprites {};
+    std::size_t scanline_sprite_count = 0;
+    bool scanline_has_semi_transparent_sprites = false;
+    std::size_t scanline_obj_window_sprite_count = 0;
+
+    void EvaluateSprites();
+
+    void RenderSpriteLayerScanline();
+    void RenderTiledSpriteScanline(const Sprite& sprite, LayerLine& line);
 
     union {
         u16 raw = 0x0000;
@@ -267,6 +263,52 @@ private:
         } flags;
     } dispstat;
 
+    enum class ColorSpecialEffect : u8 {
+        None = 0,
+        AlphaBlending = 1,
+        BrightnessIncrease = 2,
+        BrightnessDecrease = 3,
+    };
+
+    union {
+        u16 raw = 0x0000;
+        struct {
+            // BG0-3, OBJ and the backdrop, in that order.
+            u16 first_targets : 6;
+            u16 effect : 2;
+            u16 second_targets : 6;
+            u16 : 2;
+        } flags;
+    } bldcnt;
+
+    union {
+        u16 raw = 0x0000;
+        struct {
+            u16 first_target_coefficient : 5; // aka EVA
+            u16 : 3;
+            u16 second_target_coefficient : 5; // aka EVB
+            u16 : 3;
+        } flags;
+    } bldalpha;
+
+    // aka EVY
+    u8 bldy = 0;
+
+    // Both edges are in pixels, and the right and bottom ones are exclusive. A window whose
+    // left or top edge comes after its right or bottom edge wraps around the screen.
+    struct Window {
+        u8 left;
+        u8 right;
+        u8 top;
+        u8 bottom;
+    };
+
+    std::array<Window, 2> windows {};
+    // The enables of WIN0 (low byte) and WIN1 (high byte).
+    u16 winin = 0x0000;
+    // The enables outside of all windows (low byte) and inside the OBJ window (high byte).
+    u16 winout = 0x0000;
+
     struct BG {
         union {
             u16 raw;
@@ -291,8 +333,28 @@ private:
     // Scanline counter, much like LY from the gameboy
     u8 vcount = 0;
 
+    // A tile with one palette index per pixel, whatever format it is stored in.
     using Tile = std::array<std::array<u8, 8>, 8>;
 
-    Tile ConstructBGTile(const BG& bg, u16 tile_index);
-    Tile ConstructSpriteTile(const Sprite& sprite, u16 tile_index);
+    // Tiles are decoded the first time they're drawn and kept until the VRAM they come from is
+    // written to. 4bpp tiles are 32 bytes and 8bpp tiles 64 bytes, so they're indexed by their
+    // VRAM offset divided by that.
+    static constexpr std::size_t TILE_4BPP_COUNT = decltype(vram)::GetSize() / 32;
+    static constexpr std::size_t TILE_8BPP_COUNT = decltype(vram)::GetSize() / 64;
+
+    std::array<Tile, TILE_4BPP_COUNT> tiles_4bpp {};
+    std::array<Tile, TILE_8BPP_COUNT> tiles_8bpp {};
+    std::array<bool, TILE_4BPP_COUNT> dirty_tiles_4bpp {};
+    std::array<bool, TILE_8BPP_COUNT> dirty_tiles_8bpp {};
+
+    // Called by the Bus whenever VRAM from offset first to offset last (inclusive) was written to.
+    void InvalidateTiles(u32 first, u32 last);
+    ALWAYS_INLINE void InvalidateTiles(const u32 offset) {
+        dirty_tiles_4bpp[offset / 32] = true;
+        dirty_tiles_8bpp[offset / 64] = true;
+    }
+
+    [[nodiscard]] const Tile& GetTile(u32 tile_base, bool use_256_colors);
+    [[nodiscard]] const Tile& GetBGTile(const BG& bg, u16 tile_index);
+    [[nodiscard]] const Tile& GetSpriteTile(const Sprite& sprite, u16 tile_number);
 };
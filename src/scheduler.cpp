@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <utility>
+#include "bus.h"
+#include "common/logging.h"
+#include "ppu.h"
+#include "scheduler.h"
+#include "timer.h"
+
+Scheduler::Scheduler(PPU& ppu_, Timers& timers_, Bus& bus_)
+    : ppu(ppu_), timers(timers_), bus(bus_) {
+    heap_positions.fill(NOT_SCHEDULED);
+}
+
+void Scheduler::Schedule(const EventType type, const u64 cycles_from_now) {
+    const std::size_t type_index = Common::GetUnderlyingValue(type);
+    ASSERT(type_index < MAX_EVENTS);
+
+    if (heap_positions[type_index] != NOT_SCHEDULED) {
+        RemoveAt(heap_positions[type_index]);
+    }
+
+    const std::size_t position = heap_size++;
+    heap[position] = Event{timestamp + cycles_from_now, type};
+    heap_positions[type_index] = position;
+    SiftUp(position);
+}
+
+void Scheduler::Cancel(const EventType type) {
+    const std::size_t position = heap_positions[Common::GetUnderlyingValue(type)];
+    if (position != NOT_SCHEDULED) {
+        RemoveAt(position);
+    }
+}
+
+bool Scheduler::IsScheduled(const EventType type) const {
+    return heap_positions[Common::GetUnderlyingValue(type)] != NOT_SCHEDULED;
+}
+
+void Scheduler::RunPendingEvents() {
+    const u64 now = timestamp;
+
+    // Events that stall the CPU, like DMA transfers, add their cycles to the timestamp.
+    // The CPU resumes once the last of those stalls is over.
+    u64 resume_timestamp = now;
+
+    while (heap_size != 0 && heap[0].timestamp <= now) {
+        const Event event = heap[0];
+        RemoveAt(0);
+
+        // Run the event as if it happened exactly when it was due, so anything it
+        // schedules is relative to that point rather than to however late we are.
+        timestamp = event.timestamp;
+        DispatchEvent(event.type);
+
+        resume_timestamp = std::max(resume_timestamp, timestamp);
+    }
+
+    timestamp = resume_timestamp;
+}
+
+void Scheduler::DispatchEvent(const EventType type) {
+    switch (type) {
+        case EventType::HBlankStart:
+            ppu.StartHBlank();
+            break;
+        case EventType::HBlankEnd:
+            ppu.EndHBlank();
+            break;
+        case EventType::Timer0Overflow:
+            timers.HandleOverflow(0);
+            break;
+        case EventType::Timer1Overflow:
+            timers.HandleOverflow(1);
+            break;
+        case EventType::Timer2Overflow:
+            timers.HandleOverflow(2);
+            break;
+        case EventType::Timer3Overflow:
+            timers.HandleOverflow(3);
+            break;
+        case EventType::DMA0Start:
+            bus.StartDMATransfer(0);
+            break;
+        case EventType::DMA1Start:
+            bus.StartDMATransfer(1);
+            break;
+        case EventType::DMA2Start:
+            bus.StartDMATransfer(2);
+            break;
+        case EventType::DMA3Start:
+            bus.StartDMATransfer(3);
+            break;
+        default:
+            UNREACHABLE_MSG("scheduler: invalid event type {}", Common::GetUnderlyingValue(type));
+    }
+}
+
+void Scheduler::RemoveAt(const std::size_t position) {
+    ASSERT(position < heap_size);
+
+    heap_positions[Common::GetUnderlyingValue(heap[position].type)] = NOT_SCHEDULED;
+
+    const std::size_t last = --heap_size;
+    if (position == last) {
+        return;
+    }
+
+    const std::size_t moved_type_index = Common::GetUnderlyingValue(heap[last].type);
+    heap[position] = heap[last];
+    heap_positions[moved_type_index] = position;
+
+    // The event that took this slot may belong either above or below it.
+    SiftUp(position);
+    SiftDown(heap_positions[moved_type_index]);
+}
+
+void Scheduler::SiftUp(std::size_t position) {
+    while (position > 0) {
+        const std::size_t parent = (position - 1) / 2;
+        if (heap[parent].timestamp <= heap[position].timestamp) {
+            break;
+        }
+
+        SwapEvents(parent, position);
+        position = parent;
+    }
+}
+
+void Scheduler::SiftDown(std::size_t position) {
+    while (true) {
+        const std::size_t left = (position * 2) + 1;
+        const std::size_t right = left + 1;
+        std::size_t smallest = position;
+
+        if (left < heap_size && heap[left].timestamp < heap[smallest].timestamp) {
+            smallest = left;
+        }
+
+        if (right < heap_size && heap[right].timestamp < heap[smallest].timestamp) {
+            smallest = right;
+        }
+
+        if (smallest == position) {
+            break;
+        }
+
+        SwapEvents(position, smallest);
+        position = smallest;
+    }
+}
+
+void Scheduler::SwapEvents(const std::size_t a, const std::size_t b) {
+    std::swap(heap[a], heap[b]);
+    heap_positions[Common::GetUnderlyingValue(heap[a].type)] = a;
+    heap_positions[Common::GetUnderlyingValue(heap[b].type)] = b;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <array>
+#include <limits>
+#include "common/types.h"
+
+class Bus;
+class JIT;
+class PPU;
+class Timers;
+
+class Scheduler {
+public:
+    Scheduler(PPU& ppu_, Timers& timers_, Bus& bus_);
+
+    enum class EventType : u8 {
+        HBlankStart,
+        HBlankEnd,
+        Timer0Overflow,
+        Timer1Overflow,
+        Timer2Overflow,
+        Timer3Overflow,
+        DMA0Start,
+        DMA1Start,
+        DMA2Start,
+        DMA3Start,
+
+        Count,
+    };
+
+    // Each event type can only be pending once. Scheduling an event that is
+    // already pending moves it to the new timestamp.
+    void Schedule(EventType type, u64 cycles_from_now);
+    void Cancel(EventType type);
+    [[nodiscard]] bool IsScheduled(EventType type) const;
+
+    // Advances the global timestamp without running any events. Callers are expected
+    // to call RunPendingEvents() once the timestamp reaches GetNextEventTimestamp().
+    void AddCycles(const u64 cycles) { timestamp += cycles; }
+
+    // Runs every event whose timestamp has been reached.
+    void RunPendingEvents();
+
+    [[nodiscard]] u64 GetCurrentTimestamp() const { return timestamp; }
+
+    [[nodiscard]] u64 GetNextEventTimestamp() const {
+        if (heap_size == 0) {
+            return std::numeric_limits<u64>::max();
+        }
+
+        return heap[0].timestamp;
+    }
+
+private:
+    // Generated code bumps the timestamp directly.
+    friend class JIT;
+
+    PPU& ppu;
+    Timers& timers;
+    Bus& bus;
+
+    struct Event {
+        u64 timestamp;
+        EventType type;
+    };
+
+    static constexpr std::size_t MAX_EVENTS = static_cast<std::size_t>(EventType::Count);
+    static constexpr std::size_t NOT_SCHEDULED = MAX_EVENTS;
+
+    // Binary min-heap ordered by timestamp, plus the heap position of every event type
+    // so that rescheduling and cancelling don't need to search the heap.
+    std::array<Event, MAX_EVENTS> heap {};
+    std::array<std::size_t, MAX_EVENTS> heap_positions {};
+    std::size_t heap_size = 0;
+
+    u64 timestamp = 0;
+
+    void DispatchEvent(EventType type);
+
+    void RemoveAt(std::size_t position);
+    void SiftUp(std::size_t position);
+    void SiftDown(std::size_t position);
+    void SwapEvents(std::size_t a, std::size_t b);
+};
@@ -1,52 +1,122 @@
+#include "common/bits.h"
+#include "common/logging.h"
 #include "timer.h"
 
-void Timer::SetControl(const u16 value) {
-    // If the timer was off and we are now turning it on, reload the counter.
-    if (!control.flags.running && Common::IsBitSet<7>(value)) {
-        counter = reload;
+u16 Timer::GetCounter() const {
+    if (!control.flags.running || IsCountingUp()) {
+        return counter;
     }
 
+    const u64 elapsed_ticks = (scheduler.GetCurrentTimestamp() - start_timestamp) >> PRESCALER_SHIFTS[control.flags.prescaler];
+    const u64 value = counter + elapsed_ticks;
+    if (value <= 0xFFFF) {
+        return value;
+    }
+
+    // The overflow event is due but hasn't been handled yet, so account for the reload.
+    return reload + ((value - 0x10000) % (0x10000 - reload));
+}
+
+void Timer::SetControl(const u16 value) {
+    const u16 current_counter = GetCounter();
+    const auto old_control = control;
+
     control.raw = value;
 
     // Bits 3-5 and 8-15 are not used.
     Common::DisableBitRange<3, 5>(control.raw);
     Common::DisableBitRange<8, 15>(control.raw);
+
+    // If the timer was off and we are now turning it on, reload the counter.
+    if (!old_control.flags.running && control.flags.running) {
+        Restart(reload);
+        return;
+    }
+
+    // Freeze the counter at its current value only if the timing changes. Otherwise writes that
+    // just toggle the IRQ enable would throw away the part of the current tick that has elapsed.
+    const bool timing_changed = old_control.flags.running != control.flags.running ||
+                                old_control.flags.prescaler != control.flags.prescaler ||
+                                old_control.flags.countup_timing != control.flags.countup_timing;
+    if (timing_changed) {
+        Restart(current_counter);
+    }
 }
 
-void Timers::AdvanceCycles(u16 cycles, const CycleType cycle_type) {
-    ppu.AdvanceCycles(cycles);
+void Timer::Restart(const u16 value) {
+    counter = value;
+    start_timestamp = scheduler.GetCurrentTimestamp();
+    ScheduleOverflow();
+}
 
-    if (cycle_type == CycleType::None) {
+void Timer::ScheduleOverflow() {
+    if (!control.flags.running || IsCountingUp()) {
+        scheduler.Cancel(overflow_event);
         return;
     }
 
-    for (; cycles > 0; cycles--) {
-        if (timer0.control.flags.running) {
-            timer0.counter++;
-            if (timer0.counter == 0) {
-                interrupts.RequestInterrupt(Interrupts::Bits::Timer0Overflow);
-            }
-        }
+    const u64 ticks_until_overflow = 0x10000 - counter;
+    scheduler.Schedule(overflow_event, ticks_until_overflow << PRESCALER_SHIFTS[control.flags.prescaler]);
+}
 
-        if (timer1.control.flags.running) {
-            timer1.counter++;
-            if (timer1.counter == 0) {
-                interrupts.RequestInterrupt(Interrupts::Bits::Timer1Overflow);
-            }
-        }
+bool Timer::CountUp() {
+    if (!control.flags.running || !IsCountingUp()) {
+        return false;
+    }
 
-        if (timer2.control.flags.running) {
-            timer2.counter++;
-            if (timer2.counter == 0) {
-                interrupts.RequestInterrupt(Interrupts::Bits::Timer2Overflow);
-            }
-        }
+    counter++;
+    if (counter != 0) {
+        return false;
+    }
+
+    counter = reload;
+    return true;
+}
+
+void Timers::HandleOverflow(const u8 timer_no) {
+    Timer& timer = GetTimer(timer_no);
+
+    // Count-up timers overflow from Timers::HandleOverflow itself and have already reloaded.
+    if (!timer.IsCountingUp()) {
+        timer.Restart(timer.reload);
+    }
 
-        if (timer3.control.flags.running) {
-            timer3.counter++;
-            if (timer3.counter == 0) {
+    if (timer.control.flags.irq_enable) {
+        switch (timer_no) {
+            case 0:
+                interrupts.RequestInterrupt(Interrupts::Bits::Timer0Overflow);
+                break;
+            case 1:
+                interrupts.RequestInterrupt(Interrupts::Bits::Timer1Overflow);
+                break;
+            case 2:
+                interrupts.RequestInterrupt(Interrupts::Bits::Timer2Overflow);
+                break;
+            case 3:
                 interrupts.RequestInterrupt(Interrupts::Bits::Timer3Overflow);
-            }
+                break;
+            default:
+                UNREACHABLE();
         }
     }
+
+    // Cascade into the next timer, which only does work once per overflow of this one.
+    if (timer_no < 3 && GetTimer(timer_no + 1).CountUp()) {
+        HandleOverflow(timer_no + 1);
+    }
+}
+
+Timer& Timers::GetTimer(const u8 timer_no) {
+    switch (timer_no) {
+        case 0:
+            return timer0;
+        case 1:
+            return timer1;
+        case 2:
+            return timer2;
+        case 3:
+            return timer3;
+        default:
+            UNREACHABLE();
+    }
 }
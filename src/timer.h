@@ -1,15 +1,18 @@
 #pragma once
 
+#include <array>
 #include "common/defines.h"
 #include "common/types.h"
 #include "interrupts.h"
-#include "ppu.h"
+#include "scheduler.h"
 
 class Timer {
 public:
-    explicit Timer(Interrupts& interrupts_) : interrupts(interrupts_) {}
+    Timer(Scheduler& scheduler_, Scheduler::EventType overflow_event_, bool can_count_up_)
+        : scheduler(scheduler_), overflow_event(overflow_event_), can_count_up(can_count_up_) {}
 
-    [[nodiscard]] ALWAYS_INLINE u16 GetCounter() const { return counter; }
+    // The counter isn't ticked every cycle; it is derived from the time the timer was started.
+    [[nodiscard]] u16 GetCounter() const;
     ALWAYS_INLINE void SetReload(const u16 value) { reload = value; }
 
     [[nodiscard]] ALWAYS_INLINE u16 GetControl() const { return control.raw; }
@@ -32,34 +35,48 @@ private:
     u16 counter {};
     u16 reload {};
 
-    Interrupts& interrupts;
+    // When the timer was (re)started with the counter set to `counter`.
+    u64 start_timestamp = 0;
+
+    Scheduler& scheduler;
+    const Scheduler::EventType overflow_event;
+    // Timer 0 has no previous timer to count up from.
+    const bool can_count_up;
+
+    // Number of cycles per tick for each prescaler setting, as a shift amount.
+    static constexpr std::array<u8, 4> PRESCALER_SHIFTS = {0, 6, 8, 10};
+
+    [[nodiscard]] ALWAYS_INLINE bool IsCountingUp() const {
+        return can_count_up && control.flags.countup_timing;
+    }
+
+    void Restart(u16 value);
+    void ScheduleOverflow();
+    // Returns true when the counter overflowed.
+    bool CountUp();
 };
 
 class Timers {
 public:
-    Timers(Interrupts& interrupts_, PPU& ppu_)
+    Timers(Interrupts& interrupts_, Scheduler& scheduler_)
         : interrupts(interrupts_),
-          ppu(ppu_),
-          timer0(interrupts),
-          timer1(interrupts),
-          timer2(interrupts),
-          timer3(interrupts) {}
-
-    enum class CycleType {
-        None,
-        Nonsequential,
-        Sequential,
-        Internal,
-    };
-
-    void AdvanceCycles(u16 cycles, CycleType cycle_type);
+          scheduler(scheduler_),
+          timer0(scheduler, Scheduler::EventType::Timer0Overflow, false),
+          timer1(scheduler, Scheduler::EventType::Timer1Overflow, true),
+          timer2(scheduler, Scheduler::EventType::Timer2Overflow, true),
+          timer3(scheduler, Scheduler::EventType::Timer3Overflow, true) {}
 
     [[nodiscard]] ALWAYS_INLINE u16 GetWaitstateControl() const { return waitstate_control; }
     ALWAYS_INLINE void SetWaitstateControl(const u16 value) { waitstate_control = value; }
 
 private:
+    friend class Scheduler;
+
     Interrupts& interrupts;
-    PPU& ppu;
+    Scheduler& scheduler;
+
+    void HandleOverflow(u8 timer_no);
+    Timer& GetTimer(u8 timer_no);
 
     // TODO
     u16 waitstate_control = 0;